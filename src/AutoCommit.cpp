@@ -0,0 +1,56 @@
+#include "AutoCommit.h"
+#include "Utf8.h"
+
+bool AutoCommit::parseMode(std::string_view name, Mode &mode) {
+  for (Mode m : {Mode::Off, Mode::Unique, Mode::Dominant}) {
+    if (name == modeName(m)) {
+      mode = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *AutoCommit::modeName(Mode mode) {
+  switch (mode) {
+  case Mode::Unique:
+    return "unique";
+  case Mode::Dominant:
+    return "dominant";
+  default:
+    return "off";
+  }
+}
+
+bool AutoCommit::shouldCommit(std::span<const uint32_t> candidates,
+                              const UsageRanker *ranker) const {
+  if (mode_ == Mode::Off || candidates.empty())
+    return false;
+  if (candidates.size() == 1)
+    return true;
+  return mode_ == Mode::Dominant && ranker && ranker->dominates(candidates);
+}
+
+void AutoCommit::countCommit(std::string_view text, bool automatic) {
+  chars_ += utf8::split(text, nullptr, 0);
+  ++commits_;
+  automatic_ += automatic;
+}
+
+void AutoCommit::countRetraction(std::string_view text) {
+  chars_ -= utf8::split(text, nullptr, 0);
+  --commits_;
+  --automatic_;
+  ++retracted_;
+}
+
+void AutoCommit::dumpStats(std::ostream &out) const {
+  out << "[AutoCommit] " << modeName(mode_)
+      << (chainRelate_ ? ", chained relate" : "") << ": " << keys_
+      << " keys for " << chars_ << " characters";
+  if (chars_ > 0) {
+    out << " (" << keys_ * 100 / chars_ / 100.0 << " per character)";
+  }
+  out << ", " << automatic_ << "/" << commits_ << " commits automatic ("
+      << retracted_ << " more taken back)" << std::endl;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "UsageRanker.h"
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+// When a typed code leaves nothing to choose, commit without waiting for a
+// selection key (system.auto_commit), and optionally go straight on to
+// choosing among the related words (system.chain_relate). PrevPage as the
+// next key takes an automatic commit back (see Q9Logic). One policy is
+// shared by every Q9Logic of the engine; it also counts the keys and
+// characters that pass through them, so each setting can be judged by its
+// keystrokes per character.
+class AutoCommit {
+public:
+  enum class Mode : uint8_t {
+    Off,      // Always choose
+    Unique,   // Commit a code's only candidate
+    Dominant, // Also commit a candidate the user picks far more than others
+  };
+  // "off", "unique" or "dominant"; false for anything else
+  static bool parseMode(std::string_view name, Mode &mode);
+  static const char *modeName(Mode mode);
+
+  void configure(Mode mode, bool chainRelate) {
+    mode_ = mode;
+    chainRelate_ = chainRelate;
+  }
+  Mode mode() const { return mode_; }
+  bool chainRelate() const { return chainRelate_; }
+
+  // Whether to commit the first of a code's candidates, as ordered by
+  // ranker, right away
+  bool shouldCommit(std::span<const uint32_t> candidates,
+                    const UsageRanker *ranker) const;
+
+  void countKey() { ++keys_; }
+  void countCommit(std::string_view text, bool automatic);
+  // An automatic commit the user took back
+  void countRetraction(std::string_view text);
+  void dumpStats(std::ostream &out) const;
+
+private:
+  Mode mode_ = Mode::Off;
+  bool chainRelate_ = false;
+  uint64_t keys_ = 0;
+  uint64_t chars_ = 0;
+  uint64_t commits_ = 0;
+  uint64_t automatic_ = 0;
+  uint64_t retracted_ = 0;
+};
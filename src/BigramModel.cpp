@@ -0,0 +1,138 @@
+#include "BigramModel.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Followers seen once may be noise; they start to count from the second
+constexpr uint16_t kMinCount = 2;
+
+} // namespace
+
+BigramModel::BigramModel(size_t rows) : rows_(rows), mask_(rows - 1) {}
+
+const BigramModel::Row *BigramModel::find(uint32_t prev) const {
+  // The table is never full, so every probe ends on a free row
+  for (size_t i = slot(prev);; i = (i + 1) & mask_) {
+    const Row &row = rows_[i];
+    if (row.prev == prev)
+      return &row;
+    if (row.prev == SymbolTable::kNone)
+      return nullptr;
+  }
+}
+
+BigramModel::Row *BigramModel::find(uint32_t prev) {
+  return const_cast<Row *>(std::as_const(*this).find(prev));
+}
+
+BigramModel::Row &BigramModel::insert(uint32_t prev) {
+  size_t i = slot(prev);
+  while (rows_[i].prev != SymbolTable::kNone) {
+    i = (i + 1) & mask_;
+  }
+  rows_[i].prev = prev;
+  ++used_;
+  return rows_[i];
+}
+
+// Halve every count and rebuild without the rows that drop to nothing
+void BigramModel::prune() {
+  ++prunes_;
+  std::vector<Row> old(rows_.size());
+  old.swap(rows_);
+  used_ = 0;
+  for (Row &row : old) {
+    if (row.prev == SymbolTable::kNone)
+      continue;
+    for (uint16_t &count : row.count) {
+      count >>= 1;
+    }
+    if (row.count[0] != 0) {
+      insert(row.prev) = row;
+    }
+  }
+}
+
+void BigramModel::observe(uint32_t prev, uint32_t next) {
+  if (prev == SymbolTable::kNone)
+    return;
+  ++observed_;
+  Row *row = find(prev);
+  if (!row) {
+    // Keep probe chains short: at most 3/4 of the rows in use
+    while ((used_ + 1) * 4 > rows_.size() * 3) {
+      prune();
+    }
+    row = &insert(prev);
+  }
+
+  size_t i = 0;
+  while (i < kFollowers && row->count[i] != 0 && row->next[i] != next) {
+    ++i;
+  }
+  if (i == kFollowers) {
+    // Space-Saving: the least frequent follower hands over its slot, and
+    // its count, to the newcomer
+    i = kFollowers - 1;
+    row->next[i] = next;
+  } else if (row->count[i] == 0) {
+    row->next[i] = next;
+  }
+  if (row->count[i] == UINT16_MAX) {
+    // Halving keeps the order, and this follower stays above zero
+    for (uint16_t &count : row->count) {
+      count >>= 1;
+    }
+  }
+  ++row->count[i];
+  for (; i > 0 && row->count[i] > row->count[i - 1]; --i) {
+    std::swap(row->count[i], row->count[i - 1]);
+    std::swap(row->next[i], row->next[i - 1]);
+  }
+}
+
+size_t BigramModel::blend(uint32_t prev, RelateIndex::List relates,
+                          std::vector<uint32_t> &out) const {
+  out.clear();
+  if (prev != SymbolTable::kNone) {
+    if (const Row *row = find(prev)) {
+      for (size_t i = 0; i < kFollowers && row->count[i] >= kMinCount; ++i) {
+        out.push_back(row->next[i]);
+      }
+    }
+  }
+  size_t learned = out.size();
+  for (uint32_t id : relates) {
+    if (std::find(out.begin(), out.begin() + learned, id) ==
+        out.begin() + learned) {
+      out.push_back(id);
+    }
+  }
+  return learned;
+}
+
+void BigramModel::countRelate(std::span<const uint32_t> related,
+                              size_t learned, uint32_t next) {
+  ++relateShown_;
+  size_t page = std::min<size_t>(related.size(), 9);
+  for (size_t i = 0; i < page; ++i) {
+    if (related[i] == next) {
+      ++relateHits_;
+      learnedHits_ += i < learned;
+      return;
+    }
+  }
+}
+
+void BigramModel::dumpStats(std::ostream &out) const {
+  out << "[BigramModel] " << used_ << "/" << rows_.size() << " rows ("
+      << memoryUsage() << " bytes), " << observed_ << " pairs observed, "
+      << prunes_ << " prunes" << std::endl;
+  out << "[BigramModel] related first page: " << relateShown_
+      << " commits, " << relateHits_ << " hits";
+  if (relateShown_ > 0) {
+    out << " (" << relateHits_ * 100 / relateShown_ << "%)";
+  }
+  out << ", " << learnedHits_ << " on learned entries" << std::endl;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "RelateIndex.h"
+#include "SymbolTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// Next-character counts learned from the user's own commits. For every
+// previous character it keeps the few most frequent followers (Space-Saving
+// top-K), in a fixed number of open-addressed rows; when the rows fill up
+// all counts are halved and rows left empty are dropped, so memory stays
+// bounded however much is typed.
+//
+// The learned followers go in front of the static related candidates, and
+// the commit that follows is scored against the first page that was shown.
+class BigramModel {
+public:
+  static constexpr size_t kFollowers = 8;
+
+  // rows must be a power of two
+  explicit BigramModel(size_t rows = 4096);
+
+  // next was committed right after prev
+  void observe(uint32_t prev, uint32_t next);
+
+  // The related list for prev: learned followers (most frequent first),
+  // then relates in order without duplicates. Returns how many came from
+  // the model. Allocation-free once out has grown.
+  size_t blend(uint32_t prev, RelateIndex::List relates,
+               std::vector<uint32_t> &out) const;
+
+  // next was committed while related was on screen, its first learned
+  // entries coming from blend(). Only the first page (9) counts as shown.
+  void countRelate(std::span<const uint32_t> related, size_t learned,
+                   uint32_t next);
+
+  size_t memoryUsage() const { return rows_.capacity() * sizeof(Row); }
+  void dumpStats(std::ostream &out) const;
+
+private:
+  // Followers are kept sorted by count, highest first; count 0 is free
+  struct Row {
+    uint32_t prev = SymbolTable::kNone;
+    uint32_t next[kFollowers];
+    uint16_t count[kFollowers] = {};
+  };
+
+  Row *find(uint32_t prev);
+  const Row *find(uint32_t prev) const;
+  Row &insert(uint32_t prev);
+  void prune();
+  size_t slot(uint32_t prev) const { return (prev * 0x9E3779B1u) & mask_; }
+
+  std::vector<Row> rows_;
+  size_t mask_;
+  size_t used_ = 0;
+
+  uint64_t observed_ = 0;
+  uint64_t prunes_ = 0;
+  // First-page hits of the related list
+  uint64_t relateShown_ = 0;
+  uint64_t relateHits_ = 0;
+  uint64_t learnedHits_ = 0; // Hits on an entry the model put there
+};
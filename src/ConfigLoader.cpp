@@ -51,6 +51,11 @@ AppConfig ConfigLoader::load(const QString &path) {
   QJsonObject systemObj = root["system"].toObject();
   config.sc_output = systemObj["sc_output"].toBool(false);
   config.use_numpad = systemObj["use_numpad"].toBool(true);
+  config.preview = systemObj["preview"].toBool(false);
+  config.usage_ranking = systemObj["usage_ranking"].toBool(true);
+  config.auto_commit = systemObj["auto_commit"].toString("off");
+  config.chain_relate = systemObj["chain_relate"].toBool(false);
+  config.compose_buffer = systemObj["compose_buffer"].toInt(0);
 
   QJsonArray buttonsArray = root["buttons"].toArray();
   for (const auto &btnVal : buttonsArray) {
@@ -118,6 +123,11 @@ void ConfigLoader::save(const QString &path, const AppConfig &config) {
   QJsonObject systemObj = root["system"].toObject();
   systemObj["sc_output"] = config.sc_output;
   systemObj["use_numpad"] = config.use_numpad;
+  systemObj["preview"] = config.preview;
+  systemObj["usage_ranking"] = config.usage_ranking;
+  systemObj["auto_commit"] = config.auto_commit;
+  systemObj["chain_relate"] = config.chain_relate;
+  systemObj["compose_buffer"] = config.compose_buffer;
   root["system"] = systemObj;
 
   // Write back
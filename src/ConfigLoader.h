@@ -24,6 +24,11 @@ struct AppConfig {
   // System
   bool sc_output = false;
   bool use_numpad = true;
+  bool preview = false; // Overlay third-digit candidates on the image grid
+  bool usage_ranking = true; // Put recently chosen candidates first
+  QString auto_commit = "off"; // "off", "unique" or "dominant"
+  bool chain_relate = false;   // Choose among related words after a commit
+  int compose_buffer = 0; // Characters held in preedit per commit; 0 = off
 
   struct ButtonConfig {
     int id;
@@ -1,21 +1,51 @@
 #include "CustomEngine.h"
+#include "Utf8.h"
+#include <algorithm>
+#include <chrono>
 #include <fcitx-utils/event.h>
 #include <fcitx-utils/key.h>
 #include <fcitx-utils/keysym.h>
 #include <fcitx-utils/standardpath.h>
 #include <fcitx/addonmanager.h>
 #include <fcitx/inputcontext.h>
+#include <fcitx/inputpanel.h>
+#include <fcitx/text.h>
 #include <iostream>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
 
-CustomEngine::CustomEngine(fcitx::Instance *instance) : instance_(instance) {
+namespace {
+
+// Modification time (ns) and size of a file, {-1, -1} if it does not exist
+std::pair<int64_t, int64_t> fileStamp(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return {-1, -1};
+  return {(int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec,
+          (int64_t)st.st_size};
+}
+
+} // namespace
+
+CustomEngine::CustomEngine(fcitx::Instance *instance)
+    : instance_(instance),
+      stateFactory_([this](fcitx::InputContext &) {
+        return new Q9ContextState(database_, &ranker_, &bigrams_,
+                                  &autoCommit_);
+      }),
+      executor_(&instance->eventLoop()) {
+  instance_->inputContextManager().registerProperty("tq9State",
+                                                    &stateFactory_);
+
   // Ensure the directory exists (legacy check, still valid)
   std::string userPkgData = fcitx::StandardPath::global().userDirectory(
       fcitx::StandardPath::Type::PkgData);
   std::string cmd = "mkdir -p " + userPkgData + "/tq9";
   system(cmd.c_str());
+  usagePath_ = userPkgData + "/tq9/usage.journal";
+  overlayPath_ = userPkgData + "/tq9/overlay.txt";
 
   // Load config for key mappings FIRST - we derive database path from config
   // location
@@ -30,65 +60,245 @@ CustomEngine::CustomEngine(fcitx::Instance *instance) : instance_(instance) {
     std::cerr << "[CustomEngine] Config path: " << configPath << std::endl;
     std::cerr << "[CustomEngine] Database path: " << dbPath << std::endl;
 
-    // init logic with correct database path
-    if (!logic_.init(dbPath)) {
-      std::cerr << "Logic DB Init Failed: " << dbPath << std::endl;
-    } else {
-      std::cerr << "[CustomEngine] Logic DB initialized successfully"
-                << std::endl;
+    // init logic with correct database path, off the addon-loading thread.
+    // Opening the database, mapping the lexicon, building the indexes and
+    // reading the usage journal and overlay happen on the executor; keys
+    // pass through until it reports back.
+    overlayStamp_ = fileStamp(overlayPath_);
+    executor_.submit<Warmup>(
+        QueryExecutor::Channel::Database,
+        [this, dbPath, usagePath = usagePath_, overlayPath = overlayPath_]() {
+          Warmup warmup;
+          warmup.ok = database_.init(dbPath);
+          if (warmup.ok) {
+            warmup.usage = UsageRanker::load(usagePath);
+            warmup.overlay = UserLexicon::load(overlayPath);
+          }
+          return warmup;
+        },
+        [this, dbPath](Warmup warmup) { onWarmupFinished(warmup, dbPath); });
+
+    applyConfig(ConfigLoader::load(QString::fromStdString(configPath)));
+  }
+}
+
+namespace {
+
+// Windows virtual-key codes (as stored in config.json) of the keys the
+// engine binds, translated to fcitx keysyms. Returns 0 for anything else.
+int vkToKeysym(int vk) {
+  if (vk >= 96 && vk <= 105) // VK_NUMPAD0..9
+    return FcitxKey_KP_0 + (vk - 96);
+  if (vk >= 65 && vk <= 90) // Letters are lowercase keysyms (a=97..z=122)
+    return vk + 32;
+  if (vk >= 48 && vk <= 57) // Digits
+    return vk;
+  switch (vk) {
+  case 13: // VK_RETURN: the keypad's Enter
+    return FcitxKey_KP_Enter;
+  case 106:
+    return FcitxKey_KP_Multiply;
+  case 107:
+    return FcitxKey_KP_Add;
+  case 109:
+    return FcitxKey_KP_Subtract;
+  case 110:
+    return FcitxKey_KP_Decimal;
+  case 111:
+    return FcitxKey_KP_Divide;
+  default:
+    return 0;
+  }
+}
+
+struct DefaultBinding {
+  const char *name;
+  int vk;
+  Q9Key key;
+};
+
+// The standard numpad layout, used for any name missing from "key".
+// prev and shortcut share one key: Shortcut, or PrevPage while choosing.
+constexpr DefaultBinding kDefaultBindings[] = {
+    {"num0", 96, Q9Key::Num0},        {"num1", 97, Q9Key::Num1},
+    {"num2", 98, Q9Key::Num2},        {"num3", 99, Q9Key::Num3},
+    {"num4", 100, Q9Key::Num4},       {"num5", 101, Q9Key::Num5},
+    {"num6", 102, Q9Key::Num6},       {"num7", 103, Q9Key::Num7},
+    {"num8", 104, Q9Key::Num8},       {"num9", 105, Q9Key::Num9},
+    {"cancel", 110, Q9Key::Cancel},   {"relate", 107, Q9Key::Relate},
+    {"prev", 109, Q9Key::Shortcut},   {"shortcut", 109, Q9Key::Shortcut},
+    {"homo", 106, Q9Key::Homo},       {"openclose", 111, Q9Key::OpenClose},
+    {"phrase", -1, Q9Key::Phrase}, // Unbound unless configured
+    {"wildcard", -1, Q9Key::Wildcard},
+};
+
+} // namespace
+
+void CustomEngine::applyConfig(const AppConfig &config) {
+  use_numpad_ = config.use_numpad;
+  sc_output_ = config.sc_output;
+  preview_ = config.preview;
+  ranker_.setEnabled(config.usage_ranking);
+  AutoCommit::Mode autoCommit = AutoCommit::Mode::Off;
+  if (!AutoCommit::parseMode(config.auto_commit.toStdString(), autoCommit)) {
+    std::cerr << "[CustomEngine] Unknown auto_commit '"
+              << config.auto_commit.toStdString() << "', using off"
+              << std::endl;
+  }
+  autoCommit_.configure(autoCommit, config.chain_relate);
+  composeLimit_ = std::max(config.compose_buffer, 0);
+  if (composeLimit_ == 0) {
+    // Turned off: nothing may stay behind in the preedit
+    if (fcitx::InputContext *ic = activeContext_.get()) {
+      flushComposed(ic);
     }
+  }
+  buildKeyTable(config);
+  if (database_.isReady()) {
+    buildPreview();
+  }
 
-    AppConfig config = ConfigLoader::load(QString::fromStdString(configPath));
-    use_numpad_ = config.use_numpad;
-
-    // Build altkey -> num mapping (for num0~num9)
-    // Config stores Windows VK codes (uppercase ASCII for letters: A=65, X=88,
-    // etc) Fcitx/X11 uses keysyms where lowercase a=97, x=120, etc We need to
-    // convert: VK code -> lowercase letter keysym
-    for (int i = 0; i <= 9; ++i) {
-      QString keyName = QString("num%1").arg(i);
-      if (config.altKeys.contains(keyName)) {
-        int vkCode = config.altKeys[keyName];
-        // Convert uppercase VK code (A=65..Z=90) to lowercase keysym
-        // (a=97..z=122)
-        int keysym = (vkCode >= 65 && vkCode <= 90) ? (vkCode + 32) : vkCode;
-        altKeyToNum_[keysym] = i;
-        std::cerr << "[CustomEngine] altKey num" << i << " = " << vkCode
-                  << " -> keysym " << keysym << std::endl;
-      }
+  std::cerr << "[CustomEngine] use_numpad=" << use_numpad_
+            << " sc_output=" << sc_output_ << " preview=" << preview_
+            << " usage_ranking=" << config.usage_ranking
+            << " auto_commit=" << AutoCommit::modeName(autoCommit_.mode())
+            << " chain_relate=" << autoCommit_.chainRelate()
+            << " compose_buffer=" << composeLimit_ << std::endl;
+}
+
+// One SET_PREVIEW command per two-digit prefix: the first candidate, as the
+// user's ranking orders it, of each of the nine codes the third digit can
+// complete. Built once (and again when sc_output or the overlay may have
+// changed) so the keystroke only sends a stored line; previewFor() redoes a
+// prefix whose candidates a selection may have reordered since.
+void CustomEngine::buildPreview() {
+  for (std::string &cmd : previewCommands_) {
+    cmd.clear();
+  }
+  previewStale_.reset();
+  previewGeneration_ = ranker_.generation();
+  if (!preview_)
+    return;
+  for (int prefix = 11; prefix <= 99; ++prefix) {
+    if (prefix % 10 != 0) {
+      buildPreview(prefix);
     }
+  }
+}
 
-    // Build altkey -> command mapping
-    auto addCmd = [&](const QString &name, Q9Key cmd) {
-      if (config.altKeys.contains(name)) {
-        int vkCode = config.altKeys[name];
-        int keysym = (vkCode >= 65 && vkCode <= 90) ? (vkCode + 32) : vkCode;
-        altKeyToCmd_[keysym] = cmd;
-        std::cerr << "[CustomEngine] altKey " << name.toStdString() << " = "
-                  << vkCode << " -> keysym " << keysym << std::endl;
+void CustomEngine::buildPreview(int prefix) {
+  const Database &db = database_;
+  std::string &cmd = previewCommands_[prefix];
+  cmd = "SET_PREVIEW";
+  for (int digit = 1; digit <= 9; ++digit) {
+    Lexicon::Words words = db.getWords(prefix * 10 + digit);
+    cmd += " " + std::to_string(digit) + ":";
+    if (!words.empty()) {
+      previewIds_.assign(words.ids().begin(), words.ids().end());
+      ranker_.rank(previewIds_);
+      // Overlay words are not in the lexicon; read through the symbols
+      appendLabel(cmd, db.symbolTable().str(previewIds_[0]));
+    }
+    cmd += "|";
+  }
+  previewStale_.reset(prefix);
+}
+
+// A selection can only reorder the codes its symbol is listed under, so
+// only the prefixes of those codes need their line redone. Scores falling
+// under the ranking threshold reorder codes no selection touched, but only
+// over thousands of selections: every kPreviewRefresh, all are redone.
+void CustomEngine::markPreviewStale() {
+  constexpr uint64_t kPreviewRefresh = 1024;
+  uint64_t generation = ranker_.generation();
+  if (generation == previewGeneration_)
+    return;
+  if (generation - previewGeneration_ > 1 ||
+      generation / kPreviewRefresh != previewGeneration_ / kPreviewRefresh) {
+    previewStale_.set();
+  } else {
+    const Database &db = database_;
+    uint32_t symbol = ranker_.lastSelection();
+    auto mark = [this](int code) {
+      if (code >= 100 && code <= 999) {
+        previewStale_.set(code / 10);
       }
     };
+    for (uint16_t code : db.getCode(symbol)) {
+      mark(code);
+    }
+    // Overlay words are not in the code index
+    for (const auto &[code, edit] : db.overlayEdits()) {
+      std::span<const uint32_t> ids = db.getWords(code).ids();
+      if (std::find(ids.begin(), ids.end(), symbol) != ids.end()) {
+        mark(code);
+      }
+    }
+  }
+  previewGeneration_ = generation;
+}
 
-    addCmd("cancel", Q9Key::Cancel);
-    addCmd("relate", Q9Key::Relate);
-    addCmd("homo", Q9Key::Homo);
-    addCmd("openclose", Q9Key::OpenClose);
-    // prev and shortcut share same key, handled based on candidateMode
-    if (config.altKeys.contains("prev")) {
-      int vkCode = config.altKeys["prev"];
-      int keysym = (vkCode >= 65 && vkCode <= 90) ? (vkCode + 32) : vkCode;
-      // Store as Shortcut - we'll check candidateMode at runtime
-      altKeyToCmd_[keysym] =
-          Q9Key::Shortcut; // Treated as shortcut, but also prev
-      std::cerr << "[CustomEngine] altKey prev/shortcut = " << vkCode
-                << " -> keysym " << keysym << std::endl;
+const std::string &CustomEngine::previewFor(int prefix) {
+  markPreviewStale();
+  const std::string &cmd = previewCommands_[prefix];
+  if (!cmd.empty() && previewStale_[prefix]) {
+    buildPreview(prefix);
+  }
+  return cmd;
+}
+
+// One slot per keysym the engine can bind: Latin-1 keysyms 0x00-0xff, then
+// the 0xff00-0xffff block (keypad, function keys).
+int CustomEngine::keySlot(int sym) {
+  if (sym >= 0 && sym < 0x100)
+    return sym;
+  if (sym >= 0xff00 && sym <= 0xffff)
+    return sym - 0xff00 + 0x100;
+  return -1;
+}
+
+// Numpad mode binds the "key" section (falling back to the standard numpad
+// layout per key); alt-key mode binds "altkey" and swallows every other
+// letter so it cannot reach the application.
+void CustomEngine::buildKeyTable(const AppConfig &config) {
+  keyTable_.fill(KeyBinding());
+
+  if (!use_numpad_) {
+    for (int sym = 'a'; sym <= 'z'; ++sym) {
+      keyTable_[keySlot(sym)].type = KeyBinding::Swallow;
     }
+  }
 
-    std::cerr << "[CustomEngine] use_numpad=" << use_numpad_ << std::endl;
+  const QMap<QString, int> &keys = use_numpad_ ? config.keys : config.altKeys;
+  auto bind = [&](const char *name, int defaultVk, KeyBinding target) {
+    QString key = QString::fromLatin1(name);
+    int vk = use_numpad_ ? keys.value(key, defaultVk) : keys.value(key, -1);
+    if (vk < 0)
+      return;
+    int sym = vkToKeysym(vk);
+    int slot = keySlot(sym);
+    if (sym == 0 || slot < 0) {
+      std::cerr << "[CustomEngine] key " << name << " = " << vk
+                << " has no keysym, ignored" << std::endl;
+      return;
+    }
+    keyTable_[slot] = target;
+    std::cerr << "[CustomEngine] key " << name << " = " << vk
+              << " -> keysym " << sym << std::endl;
+  };
+  for (const DefaultBinding &binding : kDefaultBindings) {
+    bind(binding.name, binding.vk, {KeyBinding::Bound, binding.key});
   }
+  // Numpad Enter sends the compose buffer
+  bind("flush", 13, {KeyBinding::Flush});
 }
 
 CustomEngine::~CustomEngine() {
+  // The worker touches database_; let it finish before anything goes away
+  executor_.waitForIdle();
+  if (database_.isReady()) {
+    dumpStats();
+  }
   if (uiPid_ != -1) {
     sendToUI("QUIT");
     close(uiStdinFd_);
@@ -97,6 +307,25 @@ CustomEngine::~CustomEngine() {
   }
 }
 
+// Runs on the fcitx event loop once the worker has finished database_.init()
+void CustomEngine::onWarmupFinished(const Warmup &warmup,
+                                    const std::string &dbPath) {
+  if (!warmup.ok) {
+    std::cerr << "Logic DB Init Failed: " << dbPath << std::endl;
+    return;
+  }
+  std::cerr << "[CustomEngine] Logic DB initialized successfully" << std::endl;
+  // Before attaching the ranker, so words the overlay adds have ids its
+  // journal can refer to
+  database_.applyOverlay(warmup.overlay);
+  ranker_.attach(database_.symbolTable(), warmup.usage, usagePath_);
+  saveUsageIfDue();
+  buildPreview();
+  // Replace the loading status if the UI is already up
+  lastUIStateWasBase_ = false;
+  updateUIState(true);
+}
+
 void CustomEngine::spawnUI() {
   if (uiPid_ != -1)
     return;
@@ -180,21 +409,24 @@ void CustomEngine::handleUIOutput() {
     // in one read for now.
     if (data.rfind("CLICK ", 0) == 0) {
       int id = std::stoi(data.substr(6));
-      if (activeContext_) {
+      if (fcitx::InputContext *ic = activeContext_.get()) {
+        Q9Logic &logic = logicFor(ic);
         bool changed = false;
         if (id <= 9) {
-          changed = logic_.processKey(id);
+          changed = logic.processKey(id);
         } else if (id == 10) {
-          changed = logic_.processCommand(Q9Key::Cancel);
+          changed = logic.processCommand(Q9Key::Cancel);
         } else if (id == 0) {
           // Button 0 -> Page Down in Candidate Mode?
           // Logic handles 0 as NextPage or similar if mapped?
-          changed = logic_.processKey(0);
+          changed = logic.processKey(0);
         }
 
-        if (logic_.hasCommitString()) {
-          activeContext_->commitString(logic_.getCommitString());
-          logic_.clearCommitString();
+        if (logic.hasCommitString()) {
+          commitText(ic, logic.getCommitString());
+          logic.clearCommitString();
+          saveUsageIfDue();
+          markPreviewStale();
           changed = true;
         }
 
@@ -226,7 +458,7 @@ void CustomEngine::handleUIOutput() {
 
 void CustomEngine::activate(const fcitx::InputMethodEntry &entry,
                             fcitx::InputContextEvent &event) {
-  activeContext_ = event.inputContext();
+  activeContext_ = event.inputContext()->watch();
 
   if (hideTimer_) {
     hideTimer_.reset();
@@ -238,10 +470,21 @@ void CustomEngine::activate(const fcitx::InputMethodEntry &entry,
 
   spawnUI();
   sendToUI("SHOW");
+  reloadOverlayIfChanged();
+  if (executor_.busy(QueryExecutor::Channel::Database)) {
+    sendToUI("SET_STATUS 九万 載入中");
+  } else {
+    // Show where this context left off; nothing is sent if the UI already
+    // shows its state
+    updateUIState();
+  }
 }
 
 void CustomEngine::deactivate(const fcitx::InputMethodEntry &entry,
                               fcitx::InputContextEvent &event) {
+  // Leaving the context: hand over what is still composed
+  flushComposed(event.inputContext());
+
   // activeContext_ = nullptr; // Commented out to allow committing to
   // background app if floating window takes focus
 
@@ -258,20 +501,27 @@ void CustomEngine::deactivate(const fcitx::InputMethodEntry &entry,
 
 void CustomEngine::reset(const fcitx::InputMethodEntry &entry,
                          fcitx::InputContextEvent &event) {
-  Q9State state = logic_.getState();
+  fcitx::InputContext *ic = event.inputContext();
+  Q9Logic &logic = logicFor(ic);
+  const Q9State &state = logic.state();
+  bool shown = ic == activeContext_.get();
+  // The application moved the cursor or dropped focus
+  flushComposed(ic);
 
   // Only reset if there's actual input state (candidateMode or inputCode)
   // Preserve the state if we're just showing related words after a commit
-  if (state.candidateMode || !state.inputCode.empty()) {
-    sendToUI("RESET");
-    logic_.reset();
-    updateUIState();
-  } else if (!state.relatedWords.empty()) {
+  if (state.candidateMode() || !state.inputCode.empty()) {
+    logic.reset();
+    if (shown) {
+      sendToUI("RESET");
+      updateUIState();
+    }
+  } else if (shown && !state.relatedWords.empty()) {
     // We have related words to show - don't reset, but update UI
     std::cerr
         << "[CustomEngine] reset() skipped - preserving relatedWords display"
         << std::endl;
-    updateUIState();
+    updateUIState(true);
   }
   // If nothing to reset, do nothing (already in base state)
 }
@@ -280,138 +530,118 @@ void CustomEngine::keyEvent(const fcitx::InputMethodEntry &entry,
                             fcitx::KeyEvent &keyEvent) {
   if (keyEvent.isRelease())
     return;
+  // Database still warming up (or failed to open): leave the key to the
+  // application instead of swallowing it
+  if (!database_.isReady())
+    return;
   auto key = keyEvent.key();
+  fcitx::InputContext *ic = keyEvent.inputContext();
 
-  bool handled = false;
-  bool changed = false;
-  int sym = key.sym();
-
-  // When use_numpad is true, handle numpad keys
-  // When use_numpad is false, handle alt keys (regular letter keys)
-
-  if (use_numpad_) {
-    // Numpad mode - original behavior
-    if (key.isKeyPad()) {
-      // Numpad 0-9
-      if (sym >= FcitxKey_KP_0 && sym <= FcitxKey_KP_9) {
-        int num = sym - FcitxKey_KP_0;
-        changed = logic_.processKey(num);
-        handled = true;
-      }
-      // Numpad . (decimal) = Cancel
-      else if (sym == FcitxKey_KP_Decimal) {
-        changed = logic_.processCommand(Q9Key::Cancel);
-        handled = true;
-      }
-      // Numpad + = Relate
-      else if (sym == FcitxKey_KP_Add) {
-        changed = logic_.processCommand(Q9Key::Relate);
-        handled = true;
-      }
-      // Numpad - = Shortcut (when not in select mode) or PrevPage (in select
-      // mode)
-      else if (sym == FcitxKey_KP_Subtract) {
-        Q9State state = logic_.getState();
-        if (state.candidateMode) {
-          changed = logic_.processCommand(Q9Key::PrevPage);
-        } else {
-          changed = logic_.processCommand(Q9Key::Shortcut);
-        }
-        handled = true;
-      }
-      // Numpad * = Homo (toggle homophone mode)
-      else if (sym == FcitxKey_KP_Multiply) {
-        changed = logic_.processCommand(Q9Key::Homo);
-        handled = true;
-      }
-      // Numpad / = OpenClose (bracket pairs)
-      else if (sym == FcitxKey_KP_Divide) {
-        changed = logic_.processCommand(Q9Key::OpenClose);
-        handled = true;
+  int slot = keySlot(key.sym());
+  KeyBinding::Type type =
+      slot < 0 ? KeyBinding::Unbound : keyTable_[slot].type;
+  if (type == KeyBinding::Unbound && composeLimit_ == 0)
+    return;
+  if (type == KeyBinding::Unbound || type == KeyBinding::Flush) {
+    Q9ContextState &state = stateFor(ic);
+    if (state.composed.empty()) {
+      // An alt-key flush letter is still kept from the application
+      if (type == KeyBinding::Flush && !use_numpad_) {
+        keyEvent.filterAndAccept();
       }
+      return;
     }
-  } else {
-    // Alt key mode (non-numpad) - for keyboards without numpad
-    // Check for num0~num9 alt keys
-    auto numIt = altKeyToNum_.find(sym);
-    if (numIt != altKeyToNum_.end()) {
-      int num = numIt->second;
-      changed = logic_.processKey(num);
-      handled = true;
-    } else {
-      // Check for command alt keys
-      auto cmdIt = altKeyToCmd_.find(sym);
-      if (cmdIt != altKeyToCmd_.end()) {
-        Q9Key cmd = cmdIt->second;
-
-        // Special handling for shortcut/prev - same key, different behavior
-        if (cmd == Q9Key::Shortcut) {
-          Q9State state = logic_.getState();
-          if (state.candidateMode) {
-            changed = logic_.processCommand(Q9Key::PrevPage);
-          } else {
-            changed = logic_.processCommand(Q9Key::Shortcut);
-          }
-        } else {
-          changed = logic_.processCommand(cmd);
-        }
-        handled = true;
-      } else if (sym >= 'a' && sym <= 'z') {
-        // Block other letter keys when in non-numpad mode to prevent typing
-        // (mirroring C# behavior that returns true for keyCode >= 65 && keyCode
-        // <= 90)
-        handled = true;
-      }
+    if (key.sym() == FcitxKey_BackSpace) {
+      // Take back the last composed character
+      std::string &composed = state.composed;
+      size_t end = composed.size();
+      while (end > 0 && ((unsigned char)composed[end - 1] & 0xC0) == 0x80)
+        --end;
+      composed.resize(end > 0 ? end - 1 : 0);
+      --state.composedChars;
+      updateComposedPreedit(ic);
+      keyEvent.filterAndAccept();
+      return;
     }
+    // Anything else the application handles lands after the composed text
+    flushComposed(ic);
+    if (type == KeyBinding::Flush) {
+      keyEvent.filterAndAccept();
+    }
+    return;
   }
 
-  if (handled) {
-    keyEvent.filterAndAccept();
-
-    // Check for commit
-    if (logic_.hasCommitString()) {
-      std::string commitStr = logic_.getCommitString();
-
-      // Check if this is an openclose pair (2 chars) - need cursor positioning
-      Q9State state = logic_.getState();
-      // Simple check: if we just committed and came from openclose, handle
-      // cursor The openclose mode is reset after commit, so we check commit
-      // string length UTF-8 CJK pairs would be 6 bytes (2 x 3-byte chars)
-      if (commitStr.length() >= 4 && commitStr.length() <= 8) {
-        // Could be bracket pair - commit and move cursor left
-        keyEvent.inputContext()->commitString(commitStr);
-        // TODO: Send Left key to move cursor between brackets
-        // This requires additional Fcitx API or different approach
-      } else {
-        keyEvent.inputContext()->commitString(commitStr);
-      }
-      logic_.clearCommitString();
-      changed = true;
-    }
+  // Keys go to the focused context, which the UI follows
+  activeContext_ = ic->watch();
+  Q9Logic &logic = logicFor(ic);
 
-    if (changed) {
-      updateUIState();
+  bool changed = false;
+  const KeyBinding &binding = keyTable_[slot];
+  if (binding.type == KeyBinding::Bound) {
+    Q9Key cmd = binding.key;
+    // prev and shortcut share one key: PrevPage while choosing, or to take
+    // back an automatic commit
+    if (cmd == Q9Key::Shortcut &&
+        (logic.state().candidateMode() || logic.canReopen())) {
+      cmd = Q9Key::PrevPage;
     }
+    changed = logic.processCommand(cmd);
+  }
+
+  keyEvent.filterAndAccept();
+
+  if (logic.hasRetractString()) {
+    retractText(ic, logic.getRetractString());
+    logic.clearRetractString();
+  }
+
+  // Check for commit
+  if (logic.hasCommitString()) {
+    commitText(ic, logic.getCommitString());
+    logic.clearCommitString();
+    saveUsageIfDue();
+    markPreviewStale();
+    changed = true;
+  }
+
+  if (changed) {
+    updateUIState();
   }
 }
 
-void CustomEngine::updateUIState() {
-  Q9State state = logic_.getState();
+void CustomEngine::updateUIState(bool force) {
+  fcitx::InputContext *ic = activeContext_.get();
+  if (!ic)
+    return;
+  const Q9Logic &logic = logicFor(ic);
+
+  // Nothing to send if the UI already shows this version of this state
+  if (!force && &logic == renderedLogic_ &&
+      logic.version() == renderedVersion_)
+    return;
+  renderedLogic_ = &logic;
+  renderedVersion_ = logic.version();
+  const Q9State &state = logic.state();
 
   std::cerr << "[CustomEngine] updateUIState: candidateMode="
-            << state.candidateMode << " inputCode='" << state.inputCode << "'"
+            << state.candidateMode() << " inputCode='"
+            << state.inputCode.view() << "'"
             << " relatedWords.size=" << state.relatedWords.size()
-            << " pageCandidates.size=" << state.pageCandidates.size()
+            << " pageCandidates.size=" << state.pageCandidates().size()
             << std::endl;
 
-  if (state.candidateMode) {
+  if (state.candidateMode()) {
     // Candidate mode - show text on buttons 1-9
     std::string cmd = "UPDATE_BUTTONS";
-    for (size_t i = 0; i < state.pageCandidates.size(); ++i) {
-      cmd += " " + std::to_string(i + 1) + ":" + state.pageCandidates[i] + "|";
+    const SymbolTable &symbols = database_.symbolTable();
+    std::span<const uint32_t> page = state.pageCandidates();
+    for (size_t i = 0; i < page.size(); ++i) {
+      cmd += " " + std::to_string(i + 1) + ":";
+      appendLabel(cmd, symbols.str(page[i]));
+      cmd += "|";
     }
     // Clear remaining buttons
-    for (size_t i = state.pageCandidates.size(); i < 9; ++i) {
+    for (size_t i = page.size(); i < 9; ++i) {
       cmd += " " + std::to_string(i + 1) + ":|";
     }
 
@@ -447,6 +677,10 @@ void CustomEngine::updateUIState() {
       sendToUI("UPDATE_BUTTONS 0:姓氏|10:取消|");
     } else if (state.inputCode.length() == 2) {
       sendToUI("UPDATE_BUTTONS 0:選字|10:取消|");
+      const std::string &preview = previewFor(state.inputCode.value());
+      if (!preview.empty()) {
+        sendToUI(preview);
+      }
     }
 
     // Show status
@@ -454,11 +688,22 @@ void CustomEngine::updateUIState() {
       sendToUI("SET_STATUS 九万 " + state.statusPrefix);
     }
     lastUIStateWasBase_ = false;
+  } else if (state.mode == Q9Mode::Phrase) {
+    // Between the codes of a phrase: base images, codes so far in status
+    sendToUI("RESET");
+    sendToUI("SET_STATUS 九万 " + state.statusPrefix);
+    lastUIStateWasBase_ = false;
   } else if (!state.relatedWords.empty()) {
     // Show related words with base images visible
     std::string cmd = "SET_RELATED";
-    for (size_t i = 0; i < state.relatedWords.size() && i < 9; ++i) {
-      cmd += " " + std::to_string(i + 1) + ":" + state.relatedWords[i] + "|";
+    const SymbolTable &symbols = database_.symbolTable();
+    size_t i = 0;
+    for (uint32_t id : state.relatedWords) {
+      if (i == 9)
+        break;
+      cmd += " " + std::to_string(++i) + ":";
+      appendLabel(cmd, symbols.str(id));
+      cmd += "|";
     }
     cmd += " 0:標點|10:取消|";
     std::cerr << "[CustomEngine] Sending: " << cmd << std::endl;
@@ -475,6 +720,176 @@ void CustomEngine::updateUIState() {
   }
 }
 
+void CustomEngine::commitText(fcitx::InputContext *ic,
+                              std::string_view text) {
+  if (composeLimit_ > 0) {
+    Q9ContextState &state = stateFor(ic);
+    appendLabel(state.composed, text);
+    state.composedChars += utf8::split(text, nullptr, 0);
+    if (state.composedChars >= composeLimit_) {
+      flushComposed(ic);
+    } else {
+      updateComposedPreedit(ic);
+    }
+    return;
+  }
+
+  // Reuse one buffer so resolving / converting a commit does not allocate
+  outputBuffer_.clear();
+  appendLabel(outputBuffer_, text);
+  auto start = std::chrono::steady_clock::now();
+  ic->commitString(outputBuffer_);
+  commitStats_.nanoseconds += std::chrono::nanoseconds(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+  ++commitStats_.calls;
+  commitStats_.chars += utf8::split(outputBuffer_, nullptr, 0);
+}
+
+// Take back text commitText() just sent: from the compose buffer if it is
+// still there, else by erasing it in the application
+void CustomEngine::retractText(fcitx::InputContext *ic,
+                               std::string_view text) {
+  outputBuffer_.clear();
+  appendLabel(outputBuffer_, text);
+  size_t chars = utf8::split(outputBuffer_, nullptr, 0);
+  Q9ContextState &state = stateFor(ic);
+  std::string &composed = state.composed;
+  if (composed.size() >= outputBuffer_.size() &&
+      composed.compare(composed.size() - outputBuffer_.size(),
+                       std::string::npos, outputBuffer_) == 0) {
+    composed.resize(composed.size() - outputBuffer_.size());
+    state.composedChars -= chars;
+    updateComposedPreedit(ic);
+    return;
+  }
+  for (size_t i = 0; i < chars; ++i) {
+    ic->forwardKey(fcitx::Key(FcitxKey_BackSpace));
+    ic->forwardKey(fcitx::Key(FcitxKey_BackSpace), true);
+  }
+}
+
+void CustomEngine::flushComposed(fcitx::InputContext *ic) {
+  Q9ContextState &state = stateFor(ic);
+  if (state.composed.empty())
+    return;
+  // Preedit first, so the client never shows the text twice
+  ic->inputPanel().setClientPreedit(fcitx::Text());
+  ic->updatePreedit();
+  auto start = std::chrono::steady_clock::now();
+  ic->commitString(state.composed);
+  commitStats_.nanoseconds += std::chrono::nanoseconds(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+  ++commitStats_.calls;
+  commitStats_.chars += state.composedChars;
+  state.composed.clear();
+  state.composedChars = 0;
+}
+
+void CustomEngine::updateComposedPreedit(fcitx::InputContext *ic) {
+  const std::string &composed = stateFor(ic).composed;
+  fcitx::Text preedit(composed, fcitx::TextFormatFlag::Underline);
+  preedit.setCursor(composed.size());
+  ic->inputPanel().setClientPreedit(preedit);
+  ic->updatePreedit();
+}
+
+void CustomEngine::dumpStats() const {
+  database_.dumpStats(std::cerr);
+  ranker_.dumpStats(std::cerr);
+  bigrams_.dumpStats(std::cerr);
+  autoCommit_.dumpStats(std::cerr);
+  const CommitStats &stats = commitStats_;
+  std::cerr << "[CustomEngine] commits: " << stats.calls
+            << " commitString() calls for " << stats.chars << " characters";
+  if (stats.chars > 0) {
+    std::cerr << ", " << stats.nanoseconds / stats.chars
+              << " ns per character";
+  }
+  std::cerr << " (compose buffer " << composeLimit_ << ")" << std::endl;
+}
+
+void CustomEngine::appendLabel(std::string &out,
+                               std::string_view text) const {
+  if (sc_output_) {
+    database_.tcsc(text, out);
+  } else {
+    out += text;
+  }
+}
+
+void CustomEngine::reloadConfig() {
+  if (database_.isReady()) {
+    dumpStats();
+  }
+  reloadOverlayIfChanged();
+  std::string configPath = fcitx::StandardPath::global().locate(
+      fcitx::StandardPath::Type::PkgData, "tq9/config.json");
+  if (configPath.empty())
+    return;
+  // Read the file on the executor; a newer reload supersedes this one
+  executor_.submit<AppConfig>(
+      QueryExecutor::Channel::Config,
+      [configPath]() {
+        return ConfigLoader::load(QString::fromStdString(configPath));
+      },
+      [this](AppConfig config) {
+        applyConfig(config);
+        updateUIState(true);
+      });
+}
+
+void CustomEngine::saveUsageIfDue() {
+  if (ranker_.compactionDue()) {
+    executor_.submit<bool>(
+        QueryExecutor::Channel::Usage,
+        [path = usagePath_, data = ranker_.snapshot()]() {
+          return UsageRanker::writeSnapshot(path, data);
+        },
+        [this](bool ok) {
+          // After a failure, try again on the next selection, not at once
+          if (ranker_.finishCompaction(ok))
+            saveUsageIfDue();
+        });
+  } else if (ranker_.appendDue()) {
+    // Selections made while this batch is written wait for the next one
+    executor_.submit<UsageRanker::Batch>(
+        QueryExecutor::Channel::Journal,
+        [path = usagePath_, data = ranker_.takeJournal()]() mutable {
+          return UsageRanker::appendJournal(path, std::move(data));
+        },
+        [this](UsageRanker::Batch batch) {
+          if (ranker_.finishAppend(std::move(batch)))
+            saveUsageIfDue();
+        });
+  }
+}
+
+// Checked on focus-in and reload: one stat() when nothing has changed
+void CustomEngine::reloadOverlayIfChanged() {
+  if (!database_.isReady())
+    return;
+  std::pair<int64_t, int64_t> stamp = fileStamp(overlayPath_);
+  if (stamp == overlayStamp_)
+    return;
+  overlayStamp_ = stamp;
+  executor_.submit<UserLexicon::Edits>(
+      QueryExecutor::Channel::Overlay,
+      [path = overlayPath_]() { return UserLexicon::load(path); },
+      [this](UserLexicon::Edits edits) { applyOverlay(edits); });
+}
+
+void CustomEngine::applyOverlay(const UserLexicon::Edits &edits) {
+  size_t rebuilt = database_.applyOverlay(edits);
+  if (rebuilt == 0)
+    return;
+  std::cerr << "[CustomEngine] User overlay: " << rebuilt
+            << " codes rebuilt" << std::endl;
+  buildPreview();
+  updateUIState(true);
+}
+
 std::vector<fcitx::InputMethodEntry> CustomEngine::listInputMethods() {
   std::vector<fcitx::InputMethodEntry> entries;
   auto &entry = entries.emplace_back("tq9", "TQ9", "zh_HK", "tq9");
@@ -3,14 +3,38 @@
 #include "ConfigLoader.h"
 #include "Database.h"
 #include "Q9Logic.h"
+#include "QueryExecutor.h"
+#include "UsageRanker.h"
+#include <cstdint>
 #include <fcitx-utils/event.h>
+#include <fcitx-utils/trackableobject.h>
 #include <fcitx/addonfactory.h>
+#include <fcitx/inputcontextmanager.h>
+#include <fcitx/inputcontextproperty.h>
 #include <fcitx/inputmethodengine.h>
 #include <fcitx/instance.h>
+#include <array>
+#include <bitset>
 #include <memory>
-#include <unordered_map>
+#include <string>
+#include <utility>
 #include <vector>
 
+// Q9 input state of one input context. Every window keeps its own code,
+// candidates and related words; the database and what is learned from the
+// user (usage ranking, bigrams) and the auto-commit policy are shared.
+class Q9ContextState : public fcitx::InputContextProperty {
+public:
+  Q9ContextState(const Database &db, UsageRanker *ranker,
+                 BigramModel *bigrams, AutoCommit *autoCommit)
+      : logic(db, ranker, bigrams, autoCommit) {}
+  Q9Logic logic;
+  // Compose buffer (system.compose_buffer): commits held in preedit, as
+  // they will be sent
+  std::string composed;
+  size_t composedChars = 0;
+};
+
 class CustomEngine : public fcitx::InputMethodEngineV2 {
 public:
   CustomEngine(fcitx::Instance *instance);
@@ -27,21 +51,97 @@ public:
 
   std::vector<fcitx::InputMethodEntry> listInputMethods() override;
 
+  // Triggered by `fcitx5-remote -r`; re-reads config.json and dumps query
+  // statistics to the log
+  void reloadConfig() override;
+
 private:
   fcitx::Instance *instance_;
 
   void spawnUI();
   void sendToUI(const std::string &cmd);
   void handleUIOutput();
-  void updateUIState();
+  // Push the logic state to the UI; skipped when it has not changed since
+  // the last push unless force is set
+  void updateUIState(bool force = false);
+  // Result of the warm-up job: the database is open and the usage journal
+  // and user overlay have been read
+  struct Warmup {
+    bool ok = false;
+    UsageRanker::Journal usage;
+    UserLexicon::Edits overlay;
+  };
+  void onWarmupFinished(const Warmup &warmup, const std::string &dbPath);
+  void applyConfig(const AppConfig &config);
+  void buildKeyTable(const AppConfig &config);
+  void buildPreview();
+  void buildPreview(int prefix);
+  // Note the prefixes the selections since the last call may have
+  // reordered
+  void markPreviewStale();
+  // SET_PREVIEW line of a two-digit prefix, empty if there is none
+  const std::string &previewFor(int prefix);
+  // Append new selections to the usage journal on the executor, or rewrite
+  // it there once it has grown enough
+  void saveUsageIfDue();
+  // Re-read the user overlay on the executor if the file has changed
+  void reloadOverlayIfChanged();
+  void applyOverlay(const UserLexicon::Edits &edits);
 
-  // Logic
-  Q9Logic logic_;
+  // Output conversion (sc_output): commit text / append a button label.
+  // With the compose buffer on, commitText() only adds to the preedit.
+  void commitText(fcitx::InputContext *ic, std::string_view text);
+  void appendLabel(std::string &out, std::string_view text) const;
+  // Undo the commitText() of text
+  void retractText(fcitx::InputContext *ic, std::string_view text);
+  // Send the compose buffer in one commitString(), if it holds anything
+  void flushComposed(fcitx::InputContext *ic);
+  void updateComposedPreedit(fcitx::InputContext *ic);
+  void dumpStats() const;
+
+  // Logic: shared database and user models, one Q9Logic per input context
+  Database database_;
+  UsageRanker ranker_;
+  BigramModel bigrams_;
+  AutoCommit autoCommit_;
+  std::string usagePath_; // Journal of candidate selections
+  std::string overlayPath_; // User lexicon edits (see UserLexicon)
+  // Modification time and size of the overlay when last read
+  std::pair<int64_t, int64_t> overlayStamp_{-1, -1};
+  fcitx::LambdaInputContextPropertyFactory<Q9ContextState> stateFactory_;
+  Q9ContextState &stateFor(fcitx::InputContext *ic) {
+    return *ic->propertyFor(&stateFactory_);
+  }
+  Q9Logic &logicFor(fcitx::InputContext *ic) { return stateFor(ic).logic; }
+  // Blocking work (database warm-up, config reloads) runs here. Declared
+  // after database_ so it is torn down, and its worker joined, first.
+  QueryExecutor executor_;
 
   // Config - loaded from UI on INIT response
   bool use_numpad_ = true;
-  std::unordered_map<int, int> altKeyToNum_;   // Maps key code -> num (0-9)
-  std::unordered_map<int, Q9Key> altKeyToCmd_; // Maps key code -> command
+  bool sc_output_ = false; // Convert output to Simplified Chinese
+  bool preview_ = false;   // Label the 2-digit image grid (system.preview)
+  size_t composeLimit_ = 0; // Compose buffer size in characters, 0 if off
+  // SET_PREVIEW line per two-digit prefix, built by buildPreview()
+  std::array<std::string, 100> previewCommands_;
+  // Prefixes a selection may have reordered since their line was built,
+  // and the ranker_.generation() marked up to
+  std::bitset<100> previewStale_;
+  uint64_t previewGeneration_ = 0;
+  std::vector<uint32_t> previewIds_; // buildPreview() scratch
+  std::string outputBuffer_;
+
+  // Keysym -> Q9 key, rebuilt from config ("key" or "altkey" section).
+  // Looking a key up is one range check and one array read.
+  struct KeyBinding {
+    // Flush sends the compose buffer, and is only taken while it holds
+    // something
+    enum Type : uint8_t { Unbound, Bound, Swallow, Flush } type = Unbound;
+    Q9Key key = Q9Key::Num0;
+  };
+  static constexpr size_t kKeyTableSize = 512;
+  static int keySlot(int sym);
+  std::array<KeyBinding, kKeyTableSize> keyTable_{};
 
   // UI Process Management
   pid_t uiPid_ = -1;
@@ -50,10 +150,22 @@ private:
   std::unique_ptr<fcitx::EventSource> stdoutSource_;
   std::unique_ptr<fcitx::EventSource> hideTimer_;
 
-  fcitx::InputContext *activeContext_ = nullptr;
+  // Context the UI follows; cleared by fcitx when the context goes away
+  fcitx::TrackableObjectReference<fcitx::InputContext> activeContext_;
+
+  // Cost of handing text to the application, to weigh the compose buffer
+  struct CommitStats {
+    uint64_t calls = 0;       // commitString() calls
+    uint64_t chars = 0;       // Characters they carried
+    uint64_t nanoseconds = 0; // Spent inside them
+  };
+  CommitStats commitStats_;
 
   // Track if UI is already in base state (to avoid repeated RESET)
   bool lastUIStateWasBase_ = false;
+  // Q9Logic and version() last pushed to the UI
+  const Q9Logic *renderedLogic_ = nullptr;
+  uint64_t renderedVersion_ = UINT64_MAX;
 
   // Track if we're waiting for a focus check response
   // Used to prevent race condition where FOCUS_FALSE arrives after
@@ -1,5 +1,8 @@
 #include "Database.h"
+#include "Utf8.h"
+#include <cstdio>
 #include <iostream>
+#include <sys/stat.h>
 
 Database::Database() {}
 
@@ -9,6 +12,23 @@ Database::~Database() {
   }
 }
 
+// Build a file: URI for sqlite3_open_v2, escaping the characters that have
+// meaning inside a URI.
+static std::string immutableUri(const std::string &path) {
+  std::string uri = "file:";
+  for (char c : path) {
+    if (c == '?' || c == '#' || c == '%') {
+      static const char hex[] = "0123456789ABCDEF";
+      uri += '%';
+      uri += hex[(unsigned char)c >> 4];
+      uri += hex[(unsigned char)c & 0xF];
+    } else {
+      uri += c;
+    }
+  }
+  return uri + "?immutable=1";
+}
+
 bool Database::init(const std::string &dbPath) {
   std::cerr << "[Database] init: opening '" << dbPath << "'" << std::endl;
 
@@ -21,183 +41,238 @@ bool Database::init(const std::string &dbPath) {
   }
   fclose(f);
 
-  if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+  // dataset.db is never written: open it read-only and immutable (no file
+  // locking or change detection), without the connection mutex since each
+  // Database is only used from one thread at a time.
+  int flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_URI | SQLITE_OPEN_NOMUTEX;
+  if (sqlite3_open_v2(immutableUri(dbPath).c_str(), &db, flags, nullptr) !=
+      SQLITE_OK) {
     std::cerr << "[Database] init: Can't open database: " << sqlite3_errmsg(db)
               << std::endl;
     return false;
   }
+  sqlite3_exec(db, "PRAGMA mmap_size = 268435456", nullptr, nullptr, nullptr);
 
-  return true;
+  bool ok = initLexicon(dbPath);
+  if (ok) {
+    symbols.reset(lexicon);
+    buildCodeIndex();
+    buildBracketPairs();
+    wildcards.build(lexicon);
+    transcoder.load(db);
+    homophones.load(db, symbols);
+    relates.load(db, symbols);
+    // After everything that interns symbols: relate candidates are phrases
+    buildPhraseTrie();
+    dumpStats(std::cerr);
+  }
+
+  // Every query is answered from memory from here on
+  sqlite3_close(db);
+  db = nullptr;
+  if (ok) {
+    // Publishes everything built above to the thread that sees isReady()
+    ready.store(true, std::memory_order_release);
+  }
+  return ok;
 }
 
-std::vector<std::string> Database::getWords(int key) {
-  std::vector<std::string> results;
-
-  sqlite3_stmt *stmt;
-  // Note: mapped_table.id is unique, but user prompt implied word_code logic.
-  // Q9Core.cs: "SELECT characters FROM mapped_table WHERE id='{key}'"
-  std::string sql = "SELECT characters FROM mapped_table WHERE id = ?";
-
-  int prepareResult = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-  if (prepareResult == SQLITE_OK) {
-    sqlite3_bind_int(stmt, 1, key);
-    int stepResult = sqlite3_step(stmt);
-    if (stepResult == SQLITE_ROW) {
-      const unsigned char *text = sqlite3_column_text(stmt, 0);
-      if (text) {
-        std::string rawText(reinterpret_cast<const char *>(text));
-        // The characters string needs to be split.
-        // C# code: splits by text elements (unicode chars).
-        // We'll trust our splitUTF8 helper or just return as one string
-        // and let Logic split it?
-        // Q9Core.cs `sql2strs` splits it into array of chars.
-        results = splitUTF8(reinterpret_cast<const char *>(text));
-      } else {
-        // std::cerr << "[Database] getWords: text is NULL" << std::endl;
-      }
-    } else {
-      std::cerr << "[Database] getWords: no row found for key=" << key
-                << std::endl;
-    }
-  } else {
-    std::cerr << "[Database] getWords: prepare failed: " << sqlite3_errmsg(db)
-              << std::endl;
+size_t Database::applyOverlay(const UserLexicon::Edits &edits) {
+  std::vector<int> changed = overlay.apply(edits, lexicon, symbols);
+  // A code the overlay empties, or fills, leaves or joins wildcard search
+  for (int code : changed) {
+    wildcards.set(code, !getWords(code).empty());
   }
-  sqlite3_finalize(stmt);
-  return results;
+  return changed.size();
 }
 
-std::vector<std::string> Database::getRelate(const std::string &word) {
-  std::vector<std::string> results;
-  sqlite3_stmt *stmt;
-  // Q9Core.cs: "SELECT candidates FROM related_candidates_table WHERE
-  // character='{word}'" And it passed " " as splitChar.
-  std::string sql =
-      "SELECT candidates FROM related_candidates_table WHERE character = ?";
-
-  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) == SQLITE_OK) {
-    sqlite3_bind_text(stmt, 1, word.c_str(), -1, SQLITE_STATIC);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *text = sqlite3_column_text(stmt, 0);
-      if (text) {
-        // Split by space? Or just splitUTF8?
-        // C# calls `sql2strs(..., " ")`. So it expects space separated?
-        // If the DB stores "A B C", we need to split by space.
-        // We'll assume space separation for candidates.
-        // But wait, C# `sql2strs` with splitStr=" " just returns `str.Split('
-        // ')` (implied). Let's check `sql2strs` in Q9Core.cs again. It's
-        // `return str.` (truncated in ViewFile) - wait, it was truncated! Line
-        // 43: `return str.` ... I missed that! But for `keyInput` it passed
-        // default `""`, which meant split by chars. For `getRelate` it passed
-        // `" "`. So candidates are space separated.
-        std::string s(reinterpret_cast<const char *>(text));
-        size_t pos = 0;
-        while ((pos = s.find(' ')) != std::string::npos) {
-          if (pos > 0)
-            results.push_back(s.substr(0, pos));
-          s.erase(0, pos + 1);
-        }
-        if (!s.empty())
-          results.push_back(s);
-      }
-    }
+void Database::dumpStats(std::ostream &out) const {
+  out << "[Database] symbols: " << symbols.size() << " ("
+      << symbols.memoryUsage() << " bytes beyond the lexicon)" << std::endl;
+  out << "[Database] code index: " << codeList.size() << " entries ("
+      << (codeOffsets.capacity() * sizeof(uint32_t) +
+          codeList.capacity() * sizeof(uint16_t))
+      << " bytes)" << std::endl;
+  out << "[Database] homophone index: " << homophones.listCount()
+      << " lists (" << homophones.memoryUsage() << " bytes)" << std::endl;
+  out << "[Database] relate index: " << relates.memoryUsage() << " bytes"
+      << std::endl;
+  out << "[Database] wildcard index: " << wildcards.codeCount() << " codes ("
+      << wildcards.memoryUsage() << " bytes)" << std::endl;
+  out << "[Database] user overlay: " << overlay.codeCount() << " codes ("
+      << overlay.memoryUsage() << " bytes)" << std::endl;
+  out << "[Database] phrase trie: " << phrases.phraseCount() << " entries, "
+      << phrases.nodeCount() << " nodes (" << phrases.memoryUsage()
+      << " bytes)" << std::endl;
+
+  auto dumpQuery = [&out](const char *name, const QueryStats &stats) {
+    out << "[Database] " << name << ": " << stats.calls << " lookups, "
+        << stats.empty << " empty" << std::endl;
+  };
+  dumpQuery("getRelate", relateStats);
+  dumpQuery("getHomo", homoStats);
+  dumpQuery("getCode", codeStats);
+
+  uint64_t started = speculationStats[(size_t)Speculation::Started];
+  uint64_t hits = speculationStats[(size_t)Speculation::Hit];
+  out << "[Database] third-digit prefetch: " << started << " speculations, "
+      << hits << " hits";
+  if (started > 0) {
+    out << " (" << hits * 100 / started << "%)";
   }
-  sqlite3_finalize(stmt);
-  return results;
+  out << ", " << speculationStats[(size_t)Speculation::Dropped] << " dropped"
+      << std::endl;
 }
 
-std::vector<std::string> Database::getHomo(const std::string &word) {
-  std::vector<std::string> results;
-  sqlite3_stmt *stmt;
-  // Q9Core.cs: complex query
-  std::string sql = "SELECT w1.char FROM word_meta w1 INNER JOIN word_meta w2 "
-                    "ON w1.ping = w2.ping WHERE w2.char = ? ORDER BY CASE WHEN "
-                    "w1.ping2 = w2.ping2 THEN 0 ELSE 1 END ASC;";
-
-  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) == SQLITE_OK) {
-    sqlite3_bind_text(stmt, 1, word.c_str(), -1, SQLITE_STATIC);
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *text = sqlite3_column_text(stmt, 0);
-      if (text) {
-        results.push_back(std::string(reinterpret_cast<const char *>(text)));
-      }
-    }
+// Prefer the compiled lexicon next to dataset.db (dataset.lex, produced by
+// tq9-lexicon). If it is missing or older than the database, build the same
+// image in memory so getWords never has to fall back to SQL.
+bool Database::initLexicon(const std::string &dbPath) {
+  std::string lexPath = dbPath;
+  size_t dot = lexPath.rfind('.');
+  if (dot != std::string::npos && lexPath.find('/', dot) == std::string::npos)
+    lexPath.erase(dot);
+  lexPath += ".lex";
+
+  struct stat dbStat, lexStat;
+  bool fresh = stat(lexPath.c_str(), &lexStat) == 0 &&
+               stat(dbPath.c_str(), &dbStat) == 0 &&
+               lexStat.st_mtime >= dbStat.st_mtime;
+  if (fresh && lexicon.open(lexPath)) {
+    std::cerr << "[Database] init: mapped lexicon '" << lexPath << "'"
+              << std::endl;
+    return true;
   }
-  sqlite3_finalize(stmt);
-  return results;
+
+  std::cerr << "[Database] init: no usable lexicon at '" << lexPath
+            << "', building in memory" << std::endl;
+  if (!lexicon.load(db)) {
+    std::cerr << "[Database] init: ERROR - failed to build lexicon"
+              << std::endl;
+    return false;
+  }
+  return true;
 }
 
-std::string Database::tcsc(const std::string &input) {
-  // This is expensive if we query for every char. C# does loop.
-  std::string output;
-  sqlite3_stmt *stmt;
-  std::string sql =
-      "SELECT simplified FROM ts_chinese_table WHERE traditional = ? LIMIT 1";
+// Q9Core.cs answered "Find Code" with
+// "SELECT `id` FROM `mapped_table` WHERE INSTR(`characters`,'{word}')",
+// a full scan per lookup. Invert the lexicon once instead: a counting pass
+// sizes each symbol's slice, a second pass fills it. Codes are visited in
+// ascending order, so every slice comes out sorted.
+void Database::buildCodeIndex() {
+  uint32_t count = lexicon.symbolCount();
+  std::vector<uint32_t> sizes(count, 0);
+  for (uint32_t code = 0; code < Lexicon::kCodeCount; ++code) {
+    Lexicon::Words words = lexicon.words(code);
+    for (size_t i = 0; i < words.size(); ++i) {
+      ++sizes[words.id(i)];
+    }
+  }
 
-  // We need to iterate utf8 chars in input.
-  std::vector<std::string> chars = splitUTF8(input);
+  codeOffsets.assign(count + 1, 0);
+  for (uint32_t id = 0; id < count; ++id) {
+    codeOffsets[id + 1] = codeOffsets[id] + sizes[id];
+  }
+  codeList.assign(codeOffsets[count], 0);
 
-  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK) {
-    return input; // Fallback
+  std::vector<uint32_t> fill(codeOffsets.begin(), codeOffsets.end() - 1);
+  for (uint32_t code = 0; code < Lexicon::kCodeCount; ++code) {
+    Lexicon::Words words = lexicon.words(code);
+    for (size_t i = 0; i < words.size(); ++i) {
+      uint32_t id = words.id(i);
+      // A character listed twice under one code only yields the code once
+      if (fill[id] > codeOffsets[id] && codeList[fill[id] - 1] == code)
+        continue;
+      codeList[fill[id]++] = code;
+    }
   }
 
-  for (const auto &c : chars) {
-    sqlite3_reset(stmt);
-    sqlite3_bind_text(stmt, 1, c.c_str(), -1, SQLITE_STATIC);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-      const unsigned char *text = sqlite3_column_text(stmt, 0);
-      if (text)
-        output += std::string(reinterpret_cast<const char *>(text));
-    } else {
-      output += c;
+  // Close the gaps left by the skipped duplicates
+  uint32_t out = 0;
+  for (uint32_t id = 0; id < count; ++id) {
+    uint32_t begin = codeOffsets[id];
+    codeOffsets[id] = out;
+    for (uint32_t i = begin; i < fill[id]; ++i) {
+      codeList[out++] = codeList[i];
     }
   }
-  sqlite3_finalize(stmt);
-  return output;
+  codeOffsets[count] = out;
+  codeList.resize(out);
+}
+
+// Code 1 lists opening/closing brackets back to back; combine every two
+// characters into one symbol so OpenClose can offer them as candidates.
+void Database::buildBracketPairs() {
+  bracketPairs.clear();
+  Lexicon::Words chars = lexicon.words(1);
+  std::string combined;
+  for (size_t i = 0; i < chars.size(); ++i) {
+    combined += chars[i];
+  }
+
+  std::vector<utf8::Span> spans(combined.size());
+  size_t count = utf8::split(combined, spans.data(), spans.size());
+  for (size_t i = 0; i + 1 < count; i += 2) {
+    std::string_view pair(combined.data() + spans[i].offset,
+                          spans[i].length + spans[i + 1].length);
+    bracketPairs.push_back(symbols.intern(pair));
+  }
 }
 
-std::vector<int> Database::getCode(const std::string &word) {
-  std::vector<int> results;
-  sqlite3_stmt *stmt;
-  // Q9Core.cs: "SELECT `id` FROM `mapped_table` WHERE
-  // INSTR(`characters`,'{word}');" INSTR returns position (1-based) if found, 0
-  // if not found. Non-zero is truthy.
-  std::string sql =
-      "SELECT id FROM mapped_table WHERE INSTR(characters, ?) > 0";
-
-  if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) == SQLITE_OK) {
-    sqlite3_bind_text(stmt, 1, word.c_str(), -1, SQLITE_STATIC);
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-      int id = sqlite3_column_int(stmt, 0);
-      results.push_back(id);
+// Every symbol of two or more characters that can all be typed goes in
+// under its characters' codes. A character with several codes multiplies
+// the sequences, up to kMaxSequences per phrase.
+void Database::buildPhraseTrie() {
+  constexpr size_t kMaxChars = PhraseTrie::kMaxLength;
+  constexpr size_t kMaxSequences = 8;
+  std::vector<PhraseTrie::Entry> entries;
+  utf8::Span spans[kMaxChars];
+  std::vector<uint16_t> codes[kMaxChars];
+  size_t pick[kMaxChars];
+
+  for (uint32_t id = 0; id < symbols.size(); ++id) {
+    std::string_view phrase = symbols.str(id);
+    size_t count = utf8::split(phrase, spans, kMaxChars);
+    if (count < 2 || count > kMaxChars)
+      continue;
+
+    bool typable = true;
+    for (size_t i = 0; i < count && typable; ++i) {
+      std::string_view ch(phrase.data() + spans[i].offset, spans[i].length);
+      codes[i].clear();
+      for (uint16_t code : codesOf(symbols.find(ch))) {
+        if (WildcardIndex::isTypable(code)) {
+          codes[i].push_back(code);
+        }
+      }
+      typable = !codes[i].empty();
+    }
+    if (!typable)
+      continue;
+
+    // Odometer over the characters' codes
+    std::fill(pick, pick + count, 0);
+    for (size_t n = 0; n < kMaxSequences; ++n) {
+      PhraseTrie::Entry &entry = entries.emplace_back();
+      entry.phrase = id;
+      for (size_t i = 0; i < count; ++i) {
+        entry.codes[i] = codes[i][pick[i]];
+      }
+      entry.length = count;
+      size_t i = count;
+      while (i > 0 && ++pick[i - 1] == codes[i - 1].size()) {
+        pick[--i] = 0;
+      }
+      if (i == 0)
+        break;
     }
   }
-  sqlite3_finalize(stmt);
-  return results;
+  phrases.build(std::move(entries));
 }
 
-// Simple UTF-8 splitter helper
-std::vector<std::string> Database::splitUTF8(const std::string &str) {
-  std::vector<std::string> res;
-  size_t i = 0;
-  while (i < str.size()) {
-    int c = str[i];
-    int len = 0;
-    if ((c & 0x80) == 0)
-      len = 1;
-    else if ((c & 0xE0) == 0xC0)
-      len = 2;
-    else if ((c & 0xF0) == 0xE0)
-      len = 3;
-    else if ((c & 0xF8) == 0xF0)
-      len = 4;
-    else
-      len = 1; // Invalid, skip 1
-
-    if (i + len > str.size())
-      len = str.size() - i;
-    res.push_back(str.substr(i, len));
-    i += len;
-  }
-  return res;
+std::string Database::tcsc(std::string_view input) const {
+  std::string output;
+  output.reserve(input.size());
+  transcoder.convert(input, output);
+  return output;
 }
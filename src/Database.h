@@ -1,7 +1,20 @@
 #pragma once
 
+#include "HomophoneIndex.h"
+#include "Lexicon.h"
+#include "PhraseTrie.h"
+#include "RelateIndex.h"
+#include "SymbolTable.h"
+#include "Transcoder.h"
+#include "UserLexicon.h"
+#include "WildcardIndex.h"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <span>
 #include <sqlite3.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Database {
@@ -9,19 +22,124 @@ public:
   Database();
   ~Database();
 
+  // Open and index the database. Safe to call from a worker thread; nothing
+  // else may be used until isReady() returns true.
   bool init(const std::string &dbPath);
+  bool isReady() const { return ready.load(std::memory_order_acquire); }
 
   // Core Q9 Logic Queries
-  std::vector<std::string> getWords(int key);
-  std::vector<std::string> getRelate(const std::string &word);
-  std::vector<std::string> getHomo(const std::string &word);
-  std::string tcsc(const std::string &input);
+  // Candidates of a code, served from the compiled lexicon without SQL, or
+  // from the user's overlay for the codes it edits.
+  Lexicon::Words getWords(int key) const {
+    if (const std::vector<uint32_t> *ids = overlay.find(key))
+      return Lexicon::Words(&lexicon, ids->data(), ids->size());
+    return lexicon.words(key);
+  }
+  // Warm the first page of a code's candidates before it is asked for
+  void prefetchWords(int key) const { lexicon.prefetch(key, 9); }
+  // Related candidates (symbol ids) of a character, as a zero-copy view
+  RelateIndex::List getRelate(std::string_view word) const {
+    return getRelate(symbols.find(word));
+  }
+  RelateIndex::List getRelate(uint32_t symbol) const {
+    RelateIndex::List list = relates.find(symbol);
+    relateStats.record(list.empty());
+    return list;
+  }
+  // Homophones (as symbol ids), precomputed from word_meta
+  std::span<const uint32_t> getHomo(std::string_view word) const {
+    return getHomo(symbols.find(word));
+  }
+  std::span<const uint32_t> getHomo(uint32_t symbol) const {
+    std::span<const uint32_t> list = homophones.find(symbol);
+    homoStats.record(list.empty());
+    return list;
+  }
+  // Bracket pairs for OpenClose: code 1 read two characters at a time
+  std::span<const uint32_t> getBracketPairs() const { return bracketPairs; }
+  // Traditional -> Simplified, from the in-memory ts_chinese_table
+  std::string tcsc(std::string_view input) const;
+  // Same, appending to output (allocation-free once output has capacity)
+  void tcsc(std::string_view input, std::string &output) const {
+    transcoder.convert(input, output);
+  }
 
-  // Reverse lookup for "Find Code" feature (TODO if needed)
-  std::vector<int> getCode(const std::string &word);
+  // Reverse lookup for "Find Code": every code whose candidates contain the
+  // character, in ascending order. Served from an index built at init.
+  std::span<const uint16_t> getCode(std::string_view word) const {
+    return getCode(symbols.find(word));
+  }
+  std::span<const uint16_t> getCode(uint32_t symbol) const {
+    std::span<const uint16_t> codes = codesOf(symbol);
+    codeStats.record(codes.empty());
+    return codes;
+  }
+
+  // Multi-character words by the codes of their characters, for phrase
+  // input
+  const PhraseTrie &phraseTrie() const { return phrases; }
+  // Codes by their digits, for codes typed with a digit unknown
+  const WildcardIndex &wildcardIndex() const { return wildcards; }
+
+  const SymbolTable &symbolTable() const { return symbols; }
+
+  // Layer the user's lexicon edits over the system candidates, rebuilding
+  // only the codes whose edits changed. Returns how many were rebuilt.
+  size_t applyOverlay(const UserLexicon::Edits &edits);
+  // Changes whenever applyOverlay() rebuilds a code; Words views taken
+  // under an older generation may no longer be valid
+  uint64_t overlayGeneration() const { return overlay.generation(); }
+  // The codes the overlay edits, with their edits
+  const UserLexicon::Edits &overlayEdits() const { return overlay.edits(); }
+
+  // Outcome of Q9Logic's third-digit speculation, counted across contexts
+  enum class Speculation { Started, Hit, Dropped };
+  void countSpeculation(Speculation outcome) const {
+    ++speculationStats[(size_t)outcome];
+  }
+
+  // Print the size of every in-memory index and the lookup counters
+  void dumpStats(std::ostream &out) const;
 
 private:
-  sqlite3 *db = nullptr;
-  // Helper to split string by delimiter (if needed)
-  std::vector<std::string> splitUTF8(const std::string &str);
+  // Per-query lookup counters. Only touched from the fcitx thread.
+  struct QueryStats {
+    uint64_t calls = 0;
+    uint64_t empty = 0; // Character had no entry
+    void record(bool isEmpty) {
+      ++calls;
+      empty += isEmpty;
+    }
+  };
+
+  sqlite3 *db = nullptr; // Only open during init()
+  Lexicon lexicon;
+  SymbolTable symbols;
+  Transcoder transcoder;
+  HomophoneIndex homophones;
+  RelateIndex relates;
+  mutable QueryStats relateStats, homoStats, codeStats;
+  mutable uint64_t speculationStats[3] = {};
+  std::atomic<bool> ready{false}; // Set once init() has succeeded
+
+  // Character -> codes inverted index, by lexicon symbol id
+  std::vector<uint32_t> codeOffsets{0};
+  std::vector<uint16_t> codeList;
+  std::vector<uint32_t> bracketPairs;
+  PhraseTrie phrases;
+  WildcardIndex wildcards;
+  UserLexicon overlay;
+
+  std::span<const uint16_t> codesOf(uint32_t symbol) const {
+    if (symbol >= codeOffsets.size() - 1)
+      return {};
+    return std::span<const uint16_t>(codeList.data() + codeOffsets[symbol],
+                                     codeOffsets[symbol + 1] -
+                                         codeOffsets[symbol]);
+  }
+
+  bool initLexicon(const std::string &dbPath);
+  void buildCodeIndex();
+  void buildBracketPairs();
+  void buildPhraseTrie();
 };
@@ -0,0 +1,127 @@
+#include "HomophoneIndex.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+struct Reading {
+  uint32_t ping;
+  uint32_t ping2;
+  bool operator<(const Reading &o) const {
+    return ping != o.ping ? ping < o.ping : ping2 < o.ping2;
+  }
+  bool operator==(const Reading &o) const {
+    return ping == o.ping && ping2 == o.ping2;
+  }
+};
+
+uint32_t internKey(std::unordered_map<std::string, uint32_t> &keys,
+                   const unsigned char *text) {
+  std::string key = text ? reinterpret_cast<const char *>(text) : "";
+  return keys.emplace(key, keys.size()).first->second;
+}
+
+} // namespace
+
+// Replaces the per-lookup query of Q9Core.cs:
+//   SELECT w1.char FROM word_meta w1 INNER JOIN word_meta w2
+//   ON w1.ping = w2.ping WHERE w2.char = ?
+//   ORDER BY CASE WHEN w1.ping2 = w2.ping2 THEN 0 ELSE 1 END
+// Rows keep their table order inside each ping2 partition; a character
+// reached through several readings is listed once.
+bool HomophoneIndex::load(sqlite3 *db, SymbolTable &symbols) {
+  listOf_.clear();
+  offsets_.assign(1, 0);
+  ids_.clear();
+
+  sqlite3_stmt *stmt;
+  const char *sql = "SELECT char, ping, ping2 FROM word_meta";
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "[HomophoneIndex] load: prepare failed: "
+              << sqlite3_errmsg(db) << std::endl;
+    return false;
+  }
+
+  std::unordered_map<std::string, uint32_t> pings, ping2s;
+  std::vector<std::pair<uint32_t, Reading>> rows; // (symbol, reading)
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const unsigned char *ch = sqlite3_column_text(stmt, 0);
+    if (!ch)
+      continue;
+    uint32_t symbol = symbols.intern(reinterpret_cast<const char *>(ch));
+    Reading r{internKey(pings, sqlite3_column_text(stmt, 1)),
+              internKey(ping2s, sqlite3_column_text(stmt, 2))};
+    rows.push_back({symbol, r});
+  }
+  sqlite3_finalize(stmt);
+
+  // Members of each ping group, partitioned by ping2 (stable: table order)
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> groups(pings.size());
+  for (const auto &[symbol, r] : rows) {
+    groups[r.ping].push_back({r.ping2, symbol});
+  }
+  for (auto &g : groups) {
+    std::stable_sort(g.begin(), g.end(), [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    });
+  }
+
+  // Readings of each character, in table order without repeats
+  std::vector<std::vector<Reading>> readings(symbols.size());
+  for (const auto &[symbol, r] : rows) {
+    auto &list = readings[symbol];
+    if (std::find(list.begin(), list.end(), r) == list.end())
+      list.push_back(r);
+  }
+
+  listOf_.assign(symbols.size(), kNoList);
+  std::map<std::vector<Reading>, uint32_t> lists;
+  std::vector<bool> seen(symbols.size(), false);
+  for (uint32_t symbol = 0; symbol < readings.size(); ++symbol) {
+    const auto &key = readings[symbol];
+    if (key.empty())
+      continue;
+    auto [it, inserted] = lists.emplace(key, listCount());
+    listOf_[symbol] = it->second;
+    if (!inserted)
+      continue;
+
+    size_t begin = ids_.size();
+    auto add = [&](uint32_t id) {
+      if (!seen[id]) {
+        seen[id] = true;
+        ids_.push_back(id);
+      }
+    };
+    for (const Reading &r : key) {
+      for (const auto &[ping2, id] : groups[r.ping]) {
+        if (ping2 == r.ping2)
+          add(id);
+      }
+    }
+    for (const Reading &r : key) {
+      for (const auto &[ping2, id] : groups[r.ping]) {
+        if (ping2 != r.ping2)
+          add(id);
+      }
+    }
+    for (size_t i = begin; i < ids_.size(); ++i) {
+      seen[ids_[i]] = false;
+    }
+    offsets_.push_back(ids_.size());
+  }
+
+  ids_.shrink_to_fit();
+  std::cerr << "[HomophoneIndex] " << rows.size() << " readings, "
+            << listCount() << " lists, " << memoryUsage() << " bytes"
+            << std::endl;
+  return true;
+}
+
+size_t HomophoneIndex::memoryUsage() const {
+  return (listOf_.capacity() + offsets_.capacity() + ids_.capacity()) *
+         sizeof(uint32_t);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "SymbolTable.h"
+#include <cstdint>
+#include <span>
+#include <sqlite3.h>
+#include <vector>
+
+// Precomputed homophone lists built from word_meta.
+//
+// Characters are grouped by `ping`, and each group is ordered so that
+// characters sharing a `ping2` are contiguous. A character's homophone list
+// is its own ping2 partition first, then the rest of the ping group, once
+// per reading. Characters with the same set of readings share one list, so
+// every list is stored once as a contiguous run of symbol ids.
+class HomophoneIndex {
+public:
+  bool load(sqlite3 *db, SymbolTable &symbols);
+
+  std::span<const uint32_t> find(uint32_t symbol) const {
+    if (symbol >= listOf_.size() || listOf_[symbol] == kNoList)
+      return {};
+    uint32_t list = listOf_[symbol];
+    return std::span<const uint32_t>(ids_.data() + offsets_[list],
+                                     offsets_[list + 1] - offsets_[list]);
+  }
+
+  size_t listCount() const { return offsets_.size() - 1; }
+  size_t memoryUsage() const;
+
+private:
+  static constexpr uint32_t kNoList = 0xFFFFFFFFu;
+
+  std::vector<uint32_t> listOf_;     // symbol id -> list index
+  std::vector<uint32_t> offsets_{0}; // list index -> range in ids_
+  std::vector<uint32_t> ids_;
+};
@@ -0,0 +1,232 @@
+#include "Lexicon.h"
+#include "Utf8.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+constexpr char kMagic[8] = {'T', 'Q', '9', 'L', 'E', 'X', '\0', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t codeCount;
+  uint32_t symbolCount;
+  uint32_t entryCount;
+  uint32_t blobSize;
+  uint32_t reserved;
+};
+
+template <typename T> void append(std::vector<char> &out, const T &value) {
+  const char *p = reinterpret_cast<const char *>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+} // namespace
+
+Lexicon::Lexicon() {}
+
+Lexicon::~Lexicon() { close(); }
+
+void Lexicon::close() {
+  if (mapped_ && data_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+  heapImage_.clear();
+  data_ = nullptr;
+  size_ = 0;
+  mapped_ = false;
+  codeIndex_ = nullptr;
+  entries_ = nullptr;
+  symbolIndex_ = nullptr;
+  blob_ = nullptr;
+  symbolCount_ = 0;
+}
+
+bool Lexicon::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+    ::close(fd);
+    return false;
+  }
+
+  void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "[Lexicon] open: mmap failed for " << path << std::endl;
+    return false;
+  }
+  // open() runs during warm-up: start reading the whole image now so the
+  // first keystrokes do not fault pages in from disk.
+  madvise(addr, st.st_size, MADV_WILLNEED);
+
+  data_ = static_cast<const char *>(addr);
+  size_ = st.st_size;
+  mapped_ = true;
+  if (!attach(data_, size_)) {
+    std::cerr << "[Lexicon] open: malformed lexicon " << path << std::endl;
+    close();
+    return false;
+  }
+  return true;
+}
+
+void Lexicon::prefetch(int code, size_t limit) const {
+  Words list = words(code);
+  size_t count = std::min(limit, list.size());
+  for (size_t i = 0; i < count; ++i) {
+    __builtin_prefetch(blob_ + symbolIndex_[list.id(i)]);
+  }
+}
+
+bool Lexicon::load(sqlite3 *db) {
+  close();
+  if (!build(db, heapImage_))
+    return false;
+  data_ = heapImage_.data();
+  size_ = heapImage_.size();
+  if (!attach(data_, size_)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool Lexicon::compile(sqlite3 *db, const std::string &path) {
+  std::vector<char> image;
+  if (!build(db, image))
+    return false;
+
+  // Write to a temporary file and rename, so running sessions that have the
+  // old file mapped keep a consistent view.
+  std::string tmpPath = path + ".tmp";
+  FILE *f = fopen(tmpPath.c_str(), "wb");
+  if (!f) {
+    std::cerr << "[Lexicon] compile: can't write " << tmpPath << std::endl;
+    return false;
+  }
+  bool ok = fwrite(image.data(), 1, image.size(), f) == image.size();
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::cerr << "[Lexicon] compile: failed to write " << path << std::endl;
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Lexicon::build(sqlite3 *db, std::vector<char> &image) {
+  sqlite3_stmt *stmt;
+  const char *sql = "SELECT id, characters FROM mapped_table WHERE id >= 0 "
+                    "AND id < ? ORDER BY id";
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "[Lexicon] build: prepare failed: " << sqlite3_errmsg(db)
+              << std::endl;
+    return false;
+  }
+  sqlite3_bind_int(stmt, 1, kCodeCount);
+
+  std::vector<std::vector<uint32_t>> codes(kCodeCount);
+  std::unordered_map<std::string, uint32_t> symbolIds;
+  std::vector<uint32_t> symbolIndex{0};
+  std::string blob;
+  uint32_t entryCount = 0;
+  std::vector<utf8::Span> spans;
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int code = sqlite3_column_int(stmt, 0);
+    const char *text =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    if (!text)
+      continue;
+    // Every codepoint of the row is one candidate
+    std::string_view row(text, sqlite3_column_bytes(stmt, 1));
+    spans.resize(row.size());
+    size_t count = utf8::split(row, spans.data(), spans.size());
+    for (size_t i = 0; i < count; ++i) {
+      std::string_view ch = row.substr(spans[i].offset, spans[i].length);
+      auto [it, inserted] =
+          symbolIds.emplace(std::string(ch), symbolIndex.size() - 1);
+      if (inserted) {
+        blob.append(ch);
+        symbolIndex.push_back(blob.size());
+      }
+      codes[code].push_back(it->second);
+      ++entryCount;
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.codeCount = kCodeCount;
+  header.symbolCount = symbolIndex.size() - 1;
+  header.entryCount = entryCount;
+  header.blobSize = blob.size();
+  header.reserved = 0;
+
+  image.clear();
+  image.reserve(sizeof(Header) +
+                sizeof(uint32_t) * (kCodeCount + 1 + entryCount +
+                                    symbolIndex.size()) +
+                blob.size());
+  append(image, header);
+  uint32_t offset = 0;
+  for (const auto &ids : codes) {
+    append(image, offset);
+    offset += ids.size();
+  }
+  append(image, offset);
+  for (const auto &ids : codes) {
+    for (uint32_t id : ids)
+      append(image, id);
+  }
+  for (uint32_t off : symbolIndex)
+    append(image, off);
+  image.insert(image.end(), blob.begin(), blob.end());
+  return true;
+}
+
+bool Lexicon::attach(const char *data, size_t size) {
+  Header header;
+  memcpy(&header, data, sizeof(Header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.codeCount != kCodeCount)
+    return false;
+
+  size_t expected =
+      sizeof(Header) +
+      sizeof(uint32_t) * ((size_t)header.codeCount + 1 + header.entryCount +
+                          header.symbolCount + 1) +
+      header.blobSize;
+  if (size < expected)
+    return false;
+
+  codeIndex_ = reinterpret_cast<const uint32_t *>(data + sizeof(Header));
+  entries_ = codeIndex_ + header.codeCount + 1;
+  symbolIndex_ = entries_ + header.entryCount;
+  blob_ = reinterpret_cast<const char *>(symbolIndex_ + header.symbolCount + 1);
+  symbolCount_ = header.symbolCount;
+
+  for (uint32_t i = 0; i < header.codeCount; ++i) {
+    if (codeIndex_[i] > codeIndex_[i + 1])
+      return false;
+  }
+  return codeIndex_[header.codeCount] == header.entryCount &&
+         symbolIndex_[header.symbolCount] == header.blobSize;
+}
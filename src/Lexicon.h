@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compiled, read-only form of mapped_table.
+//
+// File layout (native endianness, all offsets in bytes from file start):
+//   Header
+//   uint32_t codeIndex[codeCount + 1]   - range into entries[] per code
+//   uint32_t entries[entryCount]        - symbol id of each candidate
+//   uint32_t symbolIndex[symbolCount+1] - range into blob[] per symbol
+//   char     blob[blobSize]             - UTF-8 text of every symbol
+//
+// The file is memory-mapped shared, so every fcitx5 session on the host
+// reads the same pages. When no compiled file is available the same image
+// is built in memory from dataset.db.
+class Lexicon {
+public:
+  // Codes 1..999 are regular Q9 codes, 1000..1009 are the shortcut pages.
+  static constexpr uint32_t kCodeCount = 1010;
+  static constexpr uint32_t kNoSymbol = 0xFFFFFFFFu;
+
+  // Lightweight view over the candidates of one code. Valid for as long as
+  // the owning Lexicon stays open. operator[] only reads the lexicon's own
+  // symbols; ids from elsewhere (a user overlay) need SymbolTable::str().
+  class Words {
+  public:
+    Words() = default;
+    Words(const Lexicon *lexicon, const uint32_t *ids, size_t count)
+        : lexicon_(lexicon), ids_(ids), count_(count) {}
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    uint32_t id(size_t i) const { return ids_[i]; }
+    std::span<const uint32_t> ids() const { return {ids_, count_}; }
+    std::string_view operator[](size_t i) const {
+      return lexicon_->symbol(ids_[i]);
+    }
+
+  private:
+    const Lexicon *lexicon_ = nullptr;
+    const uint32_t *ids_ = nullptr;
+    size_t count_ = 0;
+  };
+
+  Lexicon();
+  ~Lexicon();
+  Lexicon(const Lexicon &) = delete;
+  Lexicon &operator=(const Lexicon &) = delete;
+
+  // Map a compiled lexicon file. Returns false if missing or malformed.
+  bool open(const std::string &path);
+  // Build the lexicon in memory straight from mapped_table.
+  bool load(sqlite3 *db);
+  // Compile mapped_table into a lexicon file (used by the tq9-lexicon tool).
+  static bool compile(sqlite3 *db, const std::string &path);
+
+  bool isOpen() const { return data_ != nullptr; }
+  bool isMapped() const { return mapped_; }
+
+  Words words(int code) const {
+    if (!data_ || code < 0 || (uint32_t)code >= kCodeCount)
+      return Words();
+    uint32_t begin = codeIndex_[code];
+    return Words(this, entries_ + begin, codeIndex_[code + 1] - begin);
+  }
+
+  // Pull the ids and text of the first `limit` candidates of a code into the
+  // CPU cache ahead of use. Only a hint; never changes what words() returns.
+  void prefetch(int code, size_t limit) const;
+
+  uint32_t symbolCount() const { return symbolCount_; }
+  std::string_view symbol(uint32_t id) const {
+    if (id >= symbolCount_)
+      return std::string_view();
+    return std::string_view(blob_ + symbolIndex_[id],
+                            symbolIndex_[id + 1] - symbolIndex_[id]);
+  }
+
+private:
+  static bool build(sqlite3 *db, std::vector<char> &image);
+  bool attach(const char *data, size_t size);
+  void close();
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+  std::vector<char> heapImage_; // Backing store when built in memory
+
+  const uint32_t *codeIndex_ = nullptr;
+  const uint32_t *entries_ = nullptr;
+  const uint32_t *symbolIndex_ = nullptr;
+  const char *blob_ = nullptr;
+  uint32_t symbolCount_ = 0;
+};
@@ -0,0 +1,64 @@
+#include "PhraseTrie.h"
+
+void PhraseTrie::build(std::vector<Entry> entries) {
+  // Codes are never 0, so comparing the zero-padded arrays puts every
+  // sequence right before its extensions
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.codes != b.codes ? a.codes < b.codes
+                                        : a.phrase < b.phrase;
+            });
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const Entry &a, const Entry &b) {
+                              return a.codes == b.codes &&
+                                     a.phrase == b.phrase;
+                            }),
+                entries.end());
+
+  // Breadth first: nodes are numbered in the order they are queued, so the
+  // children of each node, queued together, get consecutive ids
+  struct Pending {
+    const Entry *begin;
+    const Entry *end;
+    size_t depth;
+  };
+  std::vector<Pending> queue;
+  queue.push_back({entries.data(), entries.data() + entries.size(), 0});
+  first_.clear();
+  labels_.assign(1, 0);
+  lists_.assign(1, 0);
+  ids_.clear();
+
+  for (size_t node = 0; node < queue.size(); ++node) {
+    Pending pending = queue[node];
+    // Sequences ending here sort before the longer ones
+    const Entry *e = pending.begin;
+    for (; e != pending.end && e->length == pending.depth; ++e) {
+      ids_.push_back(e->phrase);
+    }
+    lists_.push_back(ids_.size());
+
+    first_.push_back(queue.size());
+    while (e != pending.end) {
+      uint16_t label = e->codes[pending.depth];
+      const Entry *group = e;
+      while (e != pending.end && e->codes[pending.depth] == label) {
+        ++e;
+      }
+      labels_.push_back(label);
+      queue.push_back({group, e, pending.depth + 1});
+    }
+  }
+  first_.push_back(queue.size());
+
+  first_.shrink_to_fit();
+  labels_.shrink_to_fit();
+  lists_.shrink_to_fit();
+  ids_.shrink_to_fit();
+}
+
+size_t PhraseTrie::memoryUsage() const {
+  return (first_.capacity() + lists_.capacity() + ids_.capacity()) *
+             sizeof(uint32_t) +
+         labels_.capacity() * sizeof(uint16_t);
+}
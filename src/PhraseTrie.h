@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Phrases keyed by the Q9 codes of their characters, in a trie laid out
+// level by level: a node's children are contiguous and sorted by code, so
+// following one more code is a binary search over at most kMaxCode labels
+// (ten compares) in one small uint16_t run, however many phrases there are.
+// Each node lists the phrases (symbol ids) whose code sequence ends there.
+class PhraseTrie {
+public:
+  using Node = uint32_t;
+  static constexpr Node kRoot = 0;
+  static constexpr Node kNoNode = 0xFFFFFFFFu;
+  static constexpr int kMaxCode = 999; // Codes are 1-3 typed digits
+  static constexpr size_t kMaxLength = 8; // Characters per phrase
+
+  // One phrase under one code sequence; a phrase may be added under
+  // several sequences when its characters have several codes
+  struct Entry {
+    std::array<uint16_t, kMaxLength> codes{};
+    uint8_t length = 0;
+    uint32_t phrase = 0;
+  };
+  // Rebuild from entries (sorted and deduplicated here)
+  void build(std::vector<Entry> entries);
+
+  Node next(Node node, int code) const {
+    // Not node + 1: that wraps to 0 for kNoNode
+    if (first_.empty() || node >= first_.size() - 1 || code <= 0 ||
+        code > kMaxCode)
+      return kNoNode;
+    const uint16_t *begin = labels_.data() + first_[node];
+    const uint16_t *end = labels_.data() + first_[node + 1];
+    const uint16_t *it = std::lower_bound(begin, end, (uint16_t)code);
+    if (it == end || *it != code)
+      return kNoNode;
+    return (Node)(it - labels_.data());
+  }
+
+  std::span<const uint32_t> phrases(Node node) const {
+    if (lists_.empty() || node >= lists_.size() - 1)
+      return {};
+    return std::span<const uint32_t>(ids_.data() + lists_[node],
+                                     lists_[node + 1] - lists_[node]);
+  }
+
+  size_t nodeCount() const { return labels_.size(); }
+  size_t phraseCount() const { return ids_.size(); }
+  size_t memoryUsage() const;
+
+private:
+  std::vector<uint32_t> first_{0, 0}; // Node -> its children, by node id
+  std::vector<uint16_t> labels_{0};   // Code leading to each node
+  std::vector<uint32_t> lists_{0, 0}; // Node -> its phrases in ids_
+  std::vector<uint32_t> ids_;
+};
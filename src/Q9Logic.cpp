@@ -1,54 +1,78 @@
 #include "Q9Logic.h"
+#include "Q9Transitions.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <iostream>
+#include <utility>
 
-Q9Logic::Q9Logic() {}
+using namespace q9;
 
-Q9Logic::~Q9Logic() {}
+Q9Logic::Q9Logic(const Database &db, UsageRanker *ranker,
+                 BigramModel *bigrams, AutoCommit *autoCommit)
+    : db(db), m_ranker(ranker), m_bigrams(bigrams), m_autoCommit(autoCommit) {}
 
-bool Q9Logic::init(const std::string &dbPath) { return db.init(dbPath); }
+Q9Logic::~Q9Logic() {}
 
-void Q9Logic::clearCommitString() { m_commitString.clear(); }
+void Q9Logic::clearCommitString() { m_commit = SymbolTable::kNone; }
 
-bool Q9Logic::hasCommitString() const { return !m_commitString.empty(); }
+bool Q9Logic::hasCommitString() const { return m_commit != SymbolTable::kNone; }
 
-std::string Q9Logic::getCommitString() const { return m_commitString; }
+std::string_view Q9Logic::getCommitString() const {
+  return db.symbolTable().str(m_commit);
+}
 
-Q9State Q9Logic::getState() const { return m_state; }
+std::string_view Q9Logic::getRetractString() const {
+  return db.symbolTable().str(m_retract);
+}
 
+// Same as a fresh Q9State, but keeps the buffers' capacity
 void Q9Logic::reset() {
-  m_state = Q9State();
-  m_commitString.clear();
+  cancel();
+  m_state.hasCandidates = false;
+  m_state.lastWord = SymbolTable::kNone;
+  m_related.clear();
+  m_learned = 0;
+  m_commit = SymbolTable::kNone;
+  m_retract = SymbolTable::kNone;
+  m_autoCommitted.symbol = SymbolTable::kNone;
+  ++m_version;
 }
 
 // Cancel and reset state - mirrors C# cancel(bool cleanRelate)
 void Q9Logic::cancel(bool cleanRelate) {
-  m_state.candidateMode = false;
-  m_state.homoMode = false;
-  m_state.afterHomoMode = false;
-  m_state.openCloseMode = false;
-  m_state.shortcutMode = false;
-  m_state.inputCode = "";
+  dropSpeculation();
+  m_state.mode = Q9Mode::Idle;
+  m_state.inputCode.clear();
   m_state.page = 0;
   m_state.totalPages = 0;
   m_state.candidates.clear();
-  m_state.pageCandidates.clear();
-  m_state.statusPrefix = "";
+  m_state.statusPrefix.clear();
   m_state.imageType = 0;
 
   if (cleanRelate) {
-    m_state.relatedWords.clear();
+    m_state.relatedWords = {};
   }
 }
 
 // Start candidate selection mode - mirrors C# startSelectWord()
-void Q9Logic::startSelectWord(const std::vector<std::string> &words) {
-  if (words.empty())
+void Q9Logic::startSelectWord(std::span<const uint32_t> ids, Q9Mode mode) {
+  if (ids.empty())
     return;
 
-  m_state.candidates = words;
-  m_state.totalPages = (words.size() + 8) / 9; // ceil(size/9)
-  m_state.candidateMode = true;
-  m_state.inputCode = "";
+  m_state.candidates.assign(ids.begin(), ids.end());
+  enterCandidateMode(mode);
+}
+
+void Q9Logic::enterCandidateMode(Q9Mode mode) {
+  dropSpeculation();
+  // Bracket pairs are read two at a time and keep their order
+  if (m_ranker && mode != Q9Mode::OpenClose) {
+    m_ranker->rank(m_state.candidates);
+  }
+  m_state.totalPages = (m_state.candidates.size() + 8) / 9; // ceil(size/9)
+  m_state.mode = mode;
+  m_state.inputCode.clear();
   m_state.imageType = -1; // Signal to show text, not images
   m_state.page = 0;
   updatePage();
@@ -73,276 +97,471 @@ void Q9Logic::addPage(int delta) {
 bool Q9Logic::processKey(int key) {
   if (key < 0 || key > 9)
     return false;
+  return dispatch((Q9Key)key);
+}
 
-  if (m_state.candidateMode) {
-    // In selection mode
-    if (key == 0) {
-      // Next page
-      addPage(1);
-      return true;
+bool Q9Logic::processCommand(Q9Key cmd) {
+  if ((size_t)cmd >= kInputCount)
+    return false;
+  return dispatch(cmd);
+}
+
+bool Q9Logic::dispatch(Q9Key input) {
+  if (!isReady())
+    return false;
+
+  // An automatic commit can be taken back by the very next key only
+  uint32_t autoCommitted =
+      std::exchange(m_autoCommitted.symbol, SymbolTable::kNone);
+  if (autoCommitted != SymbolTable::kNone && input == Q9Key::PrevPage) {
+    m_autoCommit->countKey();
+    reopenAutoCommit(autoCommitted);
+    ++m_version;
+    return true;
+  }
+
+  int key = (int)input;
+  Q9Action action = kTransitions[(size_t)m_state.mode][key];
+  // Keys that mean nothing here are not keystrokes spent on a character
+  if (m_autoCommit && action != Q9Action::None) {
+    m_autoCommit->countKey();
+  }
+  bool changed = true;
+  switch (action) {
+  case Q9Action::None:
+    changed = false;
+    break;
+  case Q9Action::TypeDigit:
+    changed = typeDigit(key);
+    break;
+  case Q9Action::TypeWildcard:
+    changed = typeDigit(kAnyDigit);
+    break;
+  case Q9Action::NextPage:
+    addPage(1);
+    break;
+  case Q9Action::PrevPage:
+    addPage(-1);
+    break;
+  case Q9Action::CommitWord:
+  case Q9Action::CommitShowCode:
+  case Q9Action::CommitBracket:
+  case Q9Action::ShowHomophones: {
+    // Select candidate at position (key-1); empty buttons do nothing
+    uint32_t selected = pageSymbol(key - 1);
+    if (selected == SymbolTable::kNone) {
+      changed = false;
+    } else if (action == Q9Action::ShowHomophones) {
+      showHomophones(selected);
+    } else if (action == Q9Action::CommitBracket) {
+      commitBracket(selected);
     } else {
-      // Select candidate at position (key-1)
-      selectWord(key - 1);
-      return true;
+      commitWord(selected, action == Q9Action::CommitShowCode);
     }
+    break;
+  }
+  case Q9Action::Cancel:
+    cancel();
+    break;
+  case Q9Action::ToggleHomo:
+    changed = toggleHomo();
+    break;
+  case Q9Action::Relate:
+    changed = showRelate();
+    break;
+  case Q9Action::OpenClose:
+    changed = showOpenClose();
+    break;
+  case Q9Action::Shortcut:
+    changed = showShortcut();
+    break;
+  case Q9Action::StartPhrase:
+    changed = startPhrase();
+    break;
+  case Q9Action::ShowPhrases:
+    changed = showPhrases();
+    break;
+  }
+
+  if (changed)
+    ++m_version;
+  return changed;
+}
+
+// Input mode - accumulate code
+bool Q9Logic::typeDigit(int digit) {
+  bool pushed = digit == kAnyDigit ? m_state.inputCode.pushWildcard()
+                                   : m_state.inputCode.push(digit);
+  if (!pushed) {
+    cancel();
+    return true;
+  }
+  bool phrase = m_state.mode == Q9Mode::Phrase;
+  Q9Mode selectMode = isHomoArmed(m_state.mode) ? Q9Mode::HomoSelect
+                                                : Q9Mode::Select;
+  if (phrase) {
+    m_state.statusPrefix = m_phraseStatus;
+    m_state.statusPrefix += ' ';
+    m_state.statusPrefix += m_state.inputCode.view();
   } else {
-    // Input mode - accumulate code
-    m_state.inputCode += std::to_string(key);
-    m_state.statusPrefix = m_state.inputCode;
-
-    if (key == 0) {
-      // Key 0 ends input early - query database with current code
-      int code = 0;
-      try {
-        code = std::stoi(m_state.inputCode);
-      } catch (...) {
-        cancel();
-        return true;
-      }
+    m_state.mode =
+        isHomoArmed(m_state.mode) ? Q9Mode::HomoInput : Q9Mode::Input;
+    m_state.statusPrefix.assign(m_state.inputCode.view());
+  }
 
-      std::vector<std::string> words = db.getWords(code);
-      if (!words.empty()) {
-        startSelectWord(words);
-      } else {
-        cancel();
-      }
+  size_t codeLen = m_state.inputCode.length();
+  if (digit == 0 || codeLen == Q9Code::kMaxLength) {
+    if (phrase)
+      return addPhraseCode();
+    if (m_state.inputCode.hasWildcard()) {
+      showWildcard(selectMode);
+      applyAutoCommit();
       return true;
+    }
+    // Key 0 ends input early; a full 3-digit code queries right away
+    Lexicon::Words words = takeSpeculation(m_state.inputCode);
+    if (!words.empty()) {
+      startSelectWord(words.ids(), selectMode);
+      applyAutoCommit();
     } else {
-      // Key 1-9
-      size_t codeLen = m_state.inputCode.length();
-
-      if (codeLen == 3) {
-        // Full 3-digit code - query and show candidates
-        int code = std::stoi(m_state.inputCode);
-        std::vector<std::string> words = db.getWords(code);
-        if (!words.empty()) {
-          startSelectWord(words);
-        } else {
-          cancel();
-        }
-      } else if (codeLen == 1) {
-        // First digit - show second-level images
-        m_state.imageType = key; // 1-9
-      } else if (codeLen == 2) {
-        // Second digit - show third-level images (semi-transparent in UI)
-        m_state.imageType = 10;
-      }
-      return true;
+      cancel();
+    }
+  } else if (codeLen == 1) {
+    // First digit - show second-level images (none for an unknown one)
+    m_state.imageType = digit == kAnyDigit ? 0 : digit; // 1-9
+  } else {
+    // Second digit - show third-level images (semi-transparent in UI)
+    m_state.imageType = 10;
+    if (!phrase && !m_state.inputCode.hasWildcard()) {
+      speculate(m_state.inputCode.value());
     }
   }
-
-  return false;
+  return true;
 }
 
-void Q9Logic::updatePage() {
-  m_state.pageCandidates.clear();
-  if (m_state.candidates.empty())
-    return;
-
-  size_t start = m_state.page * 9;
-  for (size_t i = 0; i < 9; ++i) {
-    if (start + i < m_state.candidates.size()) {
-      m_state.pageCandidates.push_back(m_state.candidates[start + i]);
+// All codes matching the digits typed, merged: the first candidate of every
+// code, then the second of every code, and so on, each symbol once at its
+// best place, so each code's own candidate order carries over.
+void Q9Logic::showWildcard(Q9Mode selectMode) {
+  m_matches.clear();
+  uint32_t order = 0;
+  db.wildcardIndex().forEachMatch(m_state.inputCode.view(), [&](int code) {
+    Lexicon::Words words = db.getWords(code);
+    for (size_t i = 0; i < words.size(); ++i) {
+      m_matches.push_back({words.id(i), (uint32_t)(i << 10) | order});
     }
+    ++order;
+  });
+
+  std::sort(m_matches.begin(), m_matches.end(),
+            [](const WildcardMatch &a, const WildcardMatch &b) {
+              return a.id != b.id ? a.id < b.id : a.rank < b.rank;
+            });
+  m_matches.erase(std::unique(m_matches.begin(), m_matches.end(),
+                              [](const WildcardMatch &a,
+                                 const WildcardMatch &b) {
+                                return a.id == b.id;
+                              }),
+                  m_matches.end());
+  std::sort(m_matches.begin(), m_matches.end(),
+            [](const WildcardMatch &a, const WildcardMatch &b) {
+              return a.rank < b.rank;
+            });
+
+  if (m_matches.empty()) {
+    cancel();
+    return;
+  }
+  m_state.candidates.clear();
+  for (const WildcardMatch &match : m_matches) {
+    m_state.candidates.push_back(match.id);
   }
-  m_state.hasCandidates = !m_state.pageCandidates.empty();
+  enterCandidateMode(selectMode);
 }
 
-bool Q9Logic::processCommand(Q9Key cmd) {
-  switch (cmd) {
-  case Q9Key::Cancel:
-    cancel();
-    return true;
+bool Q9Logic::startPhrase() {
+  cancel();
+  m_state.mode = Q9Mode::Phrase;
+  m_phraseNode = PhraseTrie::kRoot;
+  m_phraseStatus = "詞";
+  m_state.statusPrefix = m_phraseStatus;
+  return true;
+}
 
-  case Q9Key::Homo:
-    // Toggle homo mode - next selection will query homophones
-    m_state.homoMode = !m_state.homoMode;
-    if (m_state.homoMode) {
-      m_state.statusPrefix = "[同音]" + m_state.statusPrefix;
-    } else {
-      std::string target = "[同音]";
-      size_t pos = m_state.statusPrefix.find(target);
-      if (pos != std::string::npos) {
-        m_state.statusPrefix.erase(pos, target.length());
-      }
-    }
-    return true;
+// A code completed in phrase input: one step down the trie, then back to
+// the base images for the next character
+bool Q9Logic::addPhraseCode() {
+  int code = m_state.inputCode.value();
+  m_state.inputCode.clear();
+  m_state.imageType = 0;
+  m_state.statusPrefix = m_phraseStatus;
 
-  case Q9Key::Relate:
-    // Show related characters for last word
-    if (!m_state.lastWord.empty()) {
-      m_state.homoMode = false;
-      m_state.statusPrefix = "[" + m_state.lastWord + "]關聯";
-      std::vector<std::string> relates = db.getRelate(m_state.lastWord);
-      if (!relates.empty()) {
-        startSelectWord(relates);
-      }
-    }
+  PhraseTrie::Node node = db.phraseTrie().next(m_phraseNode, code);
+  if (node == PhraseTrie::kNoNode) {
+    // No phrase goes on with this code; drop it so the user can retry
+    m_state.statusPrefix += " 無";
     return true;
+  }
+  m_phraseNode = node;
+  char digits[8];
+  auto result = std::to_chars(digits, digits + sizeof(digits), code);
+  m_phraseStatus += ' ';
+  m_phraseStatus.append(digits, result.ptr);
+  m_state.statusPrefix = m_phraseStatus;
+
+  size_t count = db.phraseTrie().phrases(node).size();
+  if (count > 0) {
+    result = std::to_chars(digits, digits + sizeof(digits), count);
+    m_state.statusPrefix += " (";
+    m_state.statusPrefix.append(digits, result.ptr);
+    m_state.statusPrefix += ")";
+  }
+  return true;
+}
 
-  case Q9Key::OpenClose: {
-    // Bracket pairs - query code=1 and show pairs
-    m_state.homoMode = false;
-    m_state.afterHomoMode = false;
-    m_state.openCloseMode = true;
-    m_state.statusPrefix = "「」";
-
-    std::vector<std::string> allChars = db.getWords(1);
-    if (!allChars.empty()) {
-      // Combine chars into pairs (every 2 chars)
-      std::string combined;
-      for (const auto &c : allChars) {
-        combined += c;
-      }
-      // Split into pairs of 2 characters
-      std::vector<std::string> pairs;
-      size_t i = 0;
-      while (i < combined.length()) {
-        // Get one UTF-8 character
-        int c = (unsigned char)combined[i];
-        int len1 = 1;
-        if ((c & 0x80) == 0)
-          len1 = 1;
-        else if ((c & 0xE0) == 0xC0)
-          len1 = 2;
-        else if ((c & 0xF0) == 0xE0)
-          len1 = 3;
-        else if ((c & 0xF8) == 0xF0)
-          len1 = 4;
-
-        if (i + len1 >= combined.length())
-          break;
-
-        // Get second UTF-8 character
-        c = (unsigned char)combined[i + len1];
-        int len2 = 1;
-        if ((c & 0x80) == 0)
-          len2 = 1;
-        else if ((c & 0xE0) == 0xC0)
-          len2 = 2;
-        else if ((c & 0xF0) == 0xE0)
-          len2 = 3;
-        else if ((c & 0xF8) == 0xF0)
-          len2 = 4;
-
-        pairs.push_back(combined.substr(i, len1 + len2));
-        i += len1 + len2;
-      }
-      startSelectWord(pairs);
-    }
+// The phrase key again: choose among the phrases of the codes typed, or
+// leave phrase input if none were
+bool Q9Logic::showPhrases() {
+  if (!m_state.inputCode.empty())
+    return false;
+  if (m_phraseNode == PhraseTrie::kRoot) {
+    cancel();
     return true;
   }
+  std::span<const uint32_t> phrases = db.phraseTrie().phrases(m_phraseNode);
+  if (phrases.empty())
+    return false;
+  m_state.statusPrefix = m_phraseStatus;
+  startSelectWord(phrases, Q9Mode::Select);
+  applyAutoCommit();
+  return true;
+}
 
-  case Q9Key::Shortcut:
-    // Quick selection shortcuts
-    if (!m_state.candidateMode) {
-      if (m_state.inputCode.empty()) {
-        // Show general shortcuts (code 1000)
-        m_state.statusPrefix = "速選";
-        std::vector<std::string> words = db.getWords(1000);
-        if (!words.empty()) {
-          m_state.shortcutMode = true;
-          startSelectWord(words);
-        }
-      } else if (m_state.inputCode.length() == 1) {
-        // Show category shortcuts (code 1001-1009)
-        int digit = m_state.inputCode[0] - '0';
-        m_state.statusPrefix = "速選" + m_state.inputCode;
-        std::vector<std::string> words = db.getWords(1000 + digit);
-        if (!words.empty()) {
-          m_state.shortcutMode = true;
-          startSelectWord(words);
-        }
-      }
-    }
-    return true;
+// Candidates of a code (or phrase) the user just typed are up: commit the
+// first one at once if the policy finds nothing left to choose. Homophone
+// lookups (HomoSelect) always wait for the selection.
+void Q9Logic::applyAutoCommit() {
+  if (!m_autoCommit || m_state.mode != Q9Mode::Select ||
+      !m_autoCommit->shouldCommit(m_state.candidates, m_ranker))
+    return;
+  uint32_t selected = m_state.candidates[0];
+  m_autoCommitted.lastWord = m_state.lastWord;
+  m_autoCommitted.statusPrefix = m_state.statusPrefix;
+  m_autoCommitted.candidates = m_state.candidates;
+  commitWord(selected, false, true);
+  m_autoCommitted.symbol = selected;
+}
 
-  case Q9Key::PrevPage:
-    if (m_state.candidateMode) {
-      addPage(-1);
-    }
-    return true;
+// PrevPage right after an automatic commit: the commit is withdrawn and the
+// list it was taken from comes back, so the other candidates stay within
+// reach however dominant the first one is
+void Q9Logic::reopenAutoCommit(uint32_t symbol) {
+  m_retract = symbol;
+  m_autoCommit->countRetraction(db.symbolTable().str(symbol));
+  m_state.lastWord = m_autoCommitted.lastWord;
+  buildRelated();
+  cancel();
+  m_state.statusPrefix = m_autoCommitted.statusPrefix;
+  startSelectWord(m_autoCommitted.candidates, Q9Mode::Select);
+}
 
-  case Q9Key::NextPage:
-    if (m_state.candidateMode) {
-      addPage(1);
-    }
-    return true;
+void Q9Logic::speculate(int prefix) {
+  dropSpeculation();
+  m_speculation.prefix = prefix;
+  m_speculation.overlay = db.overlayGeneration();
+  for (int digit = 0; digit <= 9; ++digit) {
+    int code = prefix * 10 + digit;
+    m_speculation.words[digit] = db.getWords(code);
+    db.prefetchWords(code);
+  }
+  db.countSpeculation(Database::Speculation::Started);
+}
 
-  default:
-    return false;
+// Candidates of the code just completed, from the speculation when it was
+// made for this prefix
+Lexicon::Words Q9Logic::takeSpeculation(const Q9Code &code) {
+  int value = code.value();
+  // A user overlay applied in between may have rebuilt the code's list
+  if (code.length() == Q9Code::kMaxLength &&
+      m_speculation.prefix == value / 10 &&
+      m_speculation.overlay == db.overlayGeneration()) {
+    Lexicon::Words words = m_speculation.words[value % 10];
+    m_speculation.prefix = -1;
+    db.countSpeculation(Database::Speculation::Hit);
+    return words;
   }
+  return db.getWords(value);
 }
 
-// Select word at index - mirrors C# selectWord(int inputInt)
-void Q9Logic::selectWord(int index) {
-  if (index < 0 || index >= (int)m_state.pageCandidates.size())
+// Input was cancelled or left for another list before the third digit
+void Q9Logic::dropSpeculation() {
+  if (m_speculation.prefix < 0)
     return;
+  m_speculation.prefix = -1;
+  db.countSpeculation(Database::Speculation::Dropped);
+}
 
-  std::string selectedWord = m_state.pageCandidates[index];
+// The page itself is a view (Q9State::pageCandidates), nothing to copy
+void Q9Logic::updatePage() {
+  m_state.hasCandidates = !m_state.pageCandidates().empty();
+}
+
+uint32_t Q9Logic::pageSymbol(int index) const {
+  std::span<const uint32_t> page = m_state.pageCandidates();
+  if (index < 0 || index >= (int)page.size())
+    return SymbolTable::kNone;
+  return page[index];
+}
 
-  if (m_state.homoMode) {
-    // Query homophones for this word, stay in selection mode
-    m_state.homoMode = false;
-    m_state.afterHomoMode = true;
-    m_state.statusPrefix = "同音[" + selectedWord + "]";
-    std::vector<std::string> homos = db.getHomo(selectedWord);
-    if (!homos.empty()) {
-      startSelectWord(homos);
+// Toggle homo mode - next selection will query homophones
+bool Q9Logic::toggleHomo() {
+  m_state.mode = homoToggled(m_state.mode);
+  if (isHomoArmed(m_state.mode)) {
+    m_state.statusPrefix.insert(0, "[同音]");
+  } else {
+    std::string_view target = "[同音]";
+    size_t pos = m_state.statusPrefix.find(target);
+    if (pos != std::string::npos) {
+      m_state.statusPrefix.erase(pos, target.length());
     }
-    return;
   }
+  return true;
+}
 
-  if (m_state.openCloseMode) {
-    // Bracket pair selected - commit with special marker for cursor positioning
-    m_state.openCloseMode = false;
-    // The UI/engine should handle positioning cursor between brackets
-    // We commit the pair and the engine inserts + moves cursor left
-    m_commitString = selectedWord;
-    cancel();
-    return;
+// Show related characters for last word
+bool Q9Logic::showRelate() {
+  if (m_state.lastWord == SymbolTable::kNone)
+    return false;
+
+  m_state.mode = homoDisarmed(m_state.mode);
+  m_state.statusPrefix = "[";
+  m_state.statusPrefix += db.symbolTable().str(m_state.lastWord);
+  m_state.statusPrefix += "]關聯";
+  if (!m_related.empty()) {
+    startSelectWord(m_related, Q9Mode::Select);
+  }
+  return true;
+}
+
+// Bracket pairs - query code=1 and show pairs
+bool Q9Logic::showOpenClose() {
+  m_state.mode = homoDisarmed(m_state.mode);
+  m_state.statusPrefix = "「」";
+  startSelectWord(db.getBracketPairs(), Q9Mode::OpenClose);
+  return true;
+}
+
+// Quick selection shortcuts
+bool Q9Logic::showShortcut() {
+  Q9Mode selectMode = isHomoArmed(m_state.mode) ? Q9Mode::HomoSelect
+                                                : Q9Mode::Select;
+  // There is no category "?"; a lone wildcard is not a digit
+  if (m_state.inputCode.hasWildcard())
+    return false;
+  if (m_state.inputCode.empty()) {
+    // Show general shortcuts (code 1000)
+    m_state.statusPrefix = "速選";
+    startSelectWord(db.getWords(1000).ids(), selectMode);
+  } else if (m_state.inputCode.length() == 1) {
+    // Show category shortcuts (code 1001-1009)
+    int digit = m_state.inputCode[0] - '0';
+    m_state.statusPrefix = "速選";
+    m_state.statusPrefix += m_state.inputCode.view();
+    startSelectWord(db.getWords(1000 + digit).ids(), selectMode);
+  }
+  return true;
+}
+
+// Query homophones for this word, stay in selection mode
+void Q9Logic::showHomophones(uint32_t selected) {
+  m_state.mode = Q9Mode::Homophone;
+  m_state.statusPrefix = "同音[";
+  m_state.statusPrefix += db.symbolTable().str(selected);
+  m_state.statusPrefix += "]";
+  startSelectWord(db.getHomo(selected), Q9Mode::Homophone);
+}
+
+// Bracket pair selected. The engine inserts the pair and should move the
+// cursor between the brackets.
+void Q9Logic::commitBracket(uint32_t selected) {
+  m_commit = selected;
+  if (m_autoCommit) {
+    m_autoCommit->countCommit(db.symbolTable().str(selected), false);
   }
+  cancel();
+}
 
-  // Normal selection - commit word
-  m_commitString = selectedWord;
+// Normal selection - mirrors C# selectWord(int inputInt)
+void Q9Logic::commitWord(uint32_t selected, bool showCode, bool automatic) {
+  std::string_view selectedWord = db.symbolTable().str(selected);
+  m_commit = selected;
+  if (m_autoCommit) {
+    m_autoCommit->countCommit(selectedWord, automatic);
+  }
+  // Only the user's own choices count: ranking what the policy committed
+  // would make a dominant candidate ever more so
+  if (m_ranker && !automatic) {
+    m_ranker->record(selected);
+  }
 
   // Store for relate feature (single character only)
   // UTF-8: typical CJK char is 3 bytes
   if (selectedWord.length() <= 4) {
-    m_state.lastWord = selectedWord;
+    if (m_bigrams && m_state.lastWord != SymbolTable::kNone) {
+      // Score the related words that were offered, then learn the pair
+      m_bigrams->countRelate(m_related, m_learned, selected);
+      m_bigrams->observe(m_state.lastWord, selected);
+    }
+    m_state.lastWord = selected;
   } else {
-    m_state.lastWord = "";
+    m_state.lastWord = SymbolTable::kNone;
   }
 
   // Query related words for display
-  std::vector<std::string> relates;
-  if (!m_state.lastWord.empty()) {
-    relates = db.getRelate(m_state.lastWord);
-  }
+  buildRelated();
 
   // Show key code if coming from homo mode
-  if (m_state.afterHomoMode) {
-    m_state.afterHomoMode = false;
-    std::vector<int> codes = db.getCode(selectedWord);
+  if (showCode) {
+    std::span<const uint16_t> codes = db.getCode(selected);
     if (!codes.empty()) {
-      std::string codesStr;
+      m_state.statusPrefix = selectedWord;
+      m_state.statusPrefix += "key:";
       for (size_t i = 0; i < codes.size() && i < 5; ++i) {
         if (i > 0)
-          codesStr += ",";
-        codesStr += std::to_string(codes[i]);
+          m_state.statusPrefix += ",";
+        char digits[8];
+        auto result = std::to_chars(digits, digits + sizeof(digits), codes[i]);
+        m_state.statusPrefix.append(digits, result.ptr);
       }
-      m_state.statusPrefix = selectedWord + "key:" + codesStr;
     }
   }
 
   // Reset state but keep related words
-  if (!relates.empty()) {
-    m_state.relatedWords = relates;
+  if (!m_related.empty()) {
+    m_state.relatedWords = m_related;
     cancel(false);
+    if (m_autoCommit && m_autoCommit->chainRelate() && !showCode) {
+      // The next key chooses a related word; cancel goes back to typing
+      showRelate();
+    }
   } else {
     cancel(true);
   }
 }
 
+void Q9Logic::buildRelated() {
+  uint32_t word = m_state.lastWord;
+  if (word == SymbolTable::kNone) {
+    m_related.clear();
+    m_learned = 0;
+  } else if (m_bigrams) {
+    m_learned = m_bigrams->blend(word, db.getRelate(word), m_related);
+  } else {
+    RelateIndex::List relates = db.getRelate(word);
+    m_related.assign(relates.begin(), relates.end());
+    m_learned = 0;
+  }
+}
+
 // Legacy - not used, keeping for compatibility
 void Q9Logic::updateCandidates() { updatePage(); }
@@ -1,7 +1,15 @@
 #pragma once
 
+#include "AutoCommit.h"
+#include "BigramModel.h"
 #include "Database.h"
+#include "UsageRanker.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class Q9Key {
@@ -20,62 +28,232 @@ enum class Q9Key {
   Homo,
   Shortcut,  // '-' key when not in select mode (1000/1001-1009)
   OpenClose, // '/' key for bracket pairs
+  Phrase,    // Start phrase input; again to choose from the phrases typed
+  Wildcard,  // A digit the user does not remember
   NextPage,
   PrevPage
 };
 
+// Where the input flow is. Every key goes through one transition table
+// indexed by mode and key (see Q9Logic.cpp). The Homo* modes are their
+// plain counterparts with the homophone key armed: the next selection
+// looks up homophones instead of committing.
+enum class Q9Mode : uint8_t {
+  Idle,      // Nothing typed
+  Input,     // Typing a code, inputCode holds the digits so far
+  Select,    // Choosing from candidates
+  Homophone, // Choosing from homophones, commit shows the key code
+  OpenClose, // Choosing a bracket pair
+  HomoIdle,
+  HomoInput,
+  HomoSelect,
+  Phrase, // Typing codes one character at a time, then choosing a phrase
+  Count
+};
+
+constexpr bool isSelectMode(Q9Mode mode) {
+  return mode == Q9Mode::Select || mode == Q9Mode::Homophone ||
+         mode == Q9Mode::OpenClose || mode == Q9Mode::HomoSelect;
+}
+
+constexpr bool isHomoArmed(Q9Mode mode) {
+  return mode == Q9Mode::HomoIdle || mode == Q9Mode::HomoInput ||
+         mode == Q9Mode::HomoSelect;
+}
+
+// Digits typed so far. A Q9 code has at most three digits, so they are kept
+// inline (with their numeric value) and typing never touches the heap.
+class Q9Code {
+public:
+  static constexpr size_t kMaxLength = 3;
+
+  bool push(int digit) {
+    if (length_ == kMaxLength)
+      return false;
+    digits_[length_++] = '0' + digit;
+    value_ = value_ * 10 + digit;
+    return true;
+  }
+  // An unknown digit: the code is then matched as a pattern (see
+  // WildcardIndex), and value() counts the digit as 0
+  bool pushWildcard() {
+    if (length_ == kMaxLength)
+      return false;
+    digits_[length_++] = WildcardIndex::kAny;
+    value_ *= 10;
+    wildcard_ = true;
+    return true;
+  }
+  void clear() {
+    length_ = 0;
+    value_ = 0;
+    wildcard_ = false;
+  }
+
+  bool empty() const { return length_ == 0; }
+  bool hasWildcard() const { return wildcard_; }
+  size_t length() const { return length_; }
+  int value() const { return value_; }
+  char operator[](size_t i) const { return digits_[i]; }
+  std::string_view view() const { return std::string_view(digits_, length_); }
+
+private:
+  char digits_[kMaxLength] = {};
+  uint8_t length_ = 0;
+  bool wildcard_ = false;
+  int value_ = 0;
+};
+
+// Candidates, related words and the last committed word are symbol ids
+// (see SymbolTable); they are resolved to UTF-8 only for display and commit.
 struct Q9State {
-  std::string inputCode;
-  std::vector<std::string> candidates;
+  Q9Code inputCode;
+  std::vector<uint32_t> candidates;
   int page = 0;
   int totalPages = 0;
   bool hasCandidates = false;
-  bool candidateMode = false;
-  // Which candidate indices correspond to buttons 1-9 on this page
-  std::vector<std::string> pageCandidates;
-
-  // Special modes
-  bool homoMode = false;
-  bool afterHomoMode = false; // Show key code after homo selection
-  bool openCloseMode = false;
-  bool shortcutMode = false; // In shortcut selection (1000+)
-  std::string lastWord;      // For relate feature
-  std::string statusPrefix;  // Current status prefix for display
+  Q9Mode mode = Q9Mode::Idle;
+
+  bool candidateMode() const { return isSelectMode(mode); }
+
+  // The candidates shown on buttons 1-9 for the current page, as a view
+  // into candidates
+  std::span<const uint32_t> pageCandidates() const {
+    size_t start = std::min(candidates.size(), (size_t)page * 9);
+    return std::span<const uint32_t>(candidates).subspan(
+        start, std::min<size_t>(9, candidates.size() - start));
+  }
+
+  uint32_t lastWord = SymbolTable::kNone; // For relate feature
+  std::string statusPrefix;               // Current status prefix for display
   int imageType = 0; // Which image set to display (0=base, 1-9=second level,
                      // 10=third level, -1=candidates)
 
   // Related words to display (shown on buttons with images visible)
-  std::vector<std::string> relatedWords;
+  std::span<const uint32_t> relatedWords;
 };
 
 class Q9Logic {
 public:
-  Q9Logic();
+  // One Q9Logic per input context; they all share one Database, which
+  // must outlive them. Keys are ignored until db.isReady(). Selections are
+  // counted in ranker, which orders the candidates, and consecutive
+  // characters in bigrams, which leads the related words, if given.
+  // autoCommit may commit a typed code without a selection; PrevPage as the
+  // very next key takes that commit back and shows the code's candidates.
+  explicit Q9Logic(const Database &db, UsageRanker *ranker = nullptr,
+                   BigramModel *bigrams = nullptr,
+                   AutoCommit *autoCommit = nullptr);
   ~Q9Logic();
 
-  bool init(const std::string &dbPath);
+  bool isReady() const { return db.isReady(); }
 
-  // Returns true if state changed and UI needs update
+  // Returns true if state changed and UI needs update (version() moved on)
   bool processKey(int key); // 0-9 for now, extended later
 
   // Extended input for generic handling
   bool processCommand(Q9Key cmd);
   void reset();
 
-  Q9State getState() const;
-  std::string getCommitString() const; // If logic decides to commit
+  // Current state, valid until the next call that changes it. version()
+  // increases on every change, so callers can skip unchanged renders.
+  const Q9State &state() const { return m_state; }
+  uint64_t version() const { return m_version; }
+
+  std::string_view getCommitString() const; // If logic decides to commit
   bool hasCommitString() const;
   void clearCommitString();
 
+  // An automatic commit that PrevPage took back: the caller removes it from
+  // the application
+  std::string_view getRetractString() const;
+  bool hasRetractString() const { return m_retract != SymbolTable::kNone; }
+  void clearRetractString() { m_retract = SymbolTable::kNone; }
+  // Whether PrevPage would take back an automatic commit now
+  bool canReopen() const {
+    return m_autoCommitted.symbol != SymbolTable::kNone;
+  }
+
+  const Database &database() const { return db; }
+
 private:
-  Database db;
+  const Database &db;
+  UsageRanker *m_ranker;
+  BigramModel *m_bigrams;
+  AutoCommit *m_autoCommit;
   Q9State m_state;
-  std::string m_commitString;
+  uint64_t m_version = 0;
+  uint32_t m_commit = SymbolTable::kNone; // Symbol to commit
+  uint32_t m_retract = SymbolTable::kNone; // Automatic commit taken back
+
+  // The last automatic commit, until the next key: what it committed, and
+  // the list and relate state it came from, for PrevPage to go back to
+  struct AutoCommitted {
+    uint32_t symbol = SymbolTable::kNone;
+    uint32_t lastWord = SymbolTable::kNone;
+    std::string statusPrefix;
+    std::vector<uint32_t> candidates;
+  };
+  AutoCommitted m_autoCommitted;
+  void reopenAutoCommit(uint32_t symbol);
+
+  // Looks up the transition for the current mode and runs it
+  bool dispatch(Q9Key input);
+
+  // Transition actions
+  static constexpr int kAnyDigit = -1; // typeDigit() for the wildcard key
+  bool typeDigit(int digit);
+  bool toggleHomo();
+  bool showRelate();
+  bool showOpenClose();
+  bool showShortcut();
+  void commitWord(uint32_t selected, bool showCode, bool automatic = false);
+  void commitBracket(uint32_t selected);
+  void showHomophones(uint32_t selected);
+  bool startPhrase();
+  bool showPhrases();
+  void showWildcard(Q9Mode selectMode);
+  void applyAutoCommit();
 
   void updateCandidates();
   void updatePage();
-  void selectWord(int index);
+  uint32_t pageSymbol(int index) const;
   void cancel(bool cleanRelate = true);
-  void startSelectWord(const std::vector<std::string> &words);
+  void startSelectWord(std::span<const uint32_t> ids, Q9Mode mode);
+  void enterCandidateMode(Q9Mode mode);
   void addPage(int delta);
+
+  // After the second digit the third can only pick one of ten codes; their
+  // candidate lists are resolved and warmed while the user reads the image
+  // grid, and the third digit takes its list from here.
+  struct Speculation {
+    int prefix = -1; // Two-digit prefix, -1 when idle
+    uint64_t overlay = 0; // Database::overlayGeneration() of words
+    std::array<Lexicon::Words, 10> words;
+  };
+  Speculation m_speculation;
+
+  // Related words of lastWord: learned followers, then the static relates.
+  // Kept until the next commit; relatedWords views it while it is shown.
+  std::vector<uint32_t> m_related;
+  size_t m_learned = 0; // Leading entries of m_related from m_bigrams
+  void buildRelated();
+
+  void speculate(int prefix);
+  Lexicon::Words takeSpeculation(const Q9Code &code);
+  void dropSpeculation();
+
+  // Phrase input: the trie node reached by the codes typed so far, and the
+  // status line listing them
+  PhraseTrie::Node m_phraseNode = PhraseTrie::kRoot;
+  std::string m_phraseStatus;
+  bool addPhraseCode();
+
+  // Wildcard search scratch: candidates of every matching code with the
+  // rank they merge at
+  struct WildcardMatch {
+    uint32_t id;
+    uint32_t rank;
+  };
+  std::vector<WildcardMatch> m_matches;
 };
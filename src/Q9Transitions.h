@@ -0,0 +1,198 @@
+#pragma once
+
+#include "Q9Logic.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The mode x key transition table behind Q9Logic::dispatch(), built at
+// compile time. Kept in its own header so tests and benchmarks can walk
+// every cell.
+namespace q9 {
+
+// What a key does in a given mode
+enum class Q9Action : uint8_t {
+  None, // Accepted, nothing changes
+  TypeDigit,
+  TypeWildcard,
+  NextPage,
+  PrevPage,
+  CommitWord,
+  CommitShowCode, // Commit and show the key code (after homophones)
+  CommitBracket,
+  ShowHomophones,
+  Cancel,
+  ToggleHomo,
+  Relate,
+  OpenClose,
+  Shortcut,
+  StartPhrase,
+  ShowPhrases,
+};
+
+constexpr size_t kModeCount = (size_t)Q9Mode::Count;
+constexpr size_t kInputCount = (size_t)Q9Key::PrevPage + 1;
+
+using TransitionTable =
+    std::array<std::array<Q9Action, kInputCount>, kModeCount>;
+
+// Action of keys 1-9 while choosing
+constexpr Q9Action selectAction(Q9Mode mode) {
+  switch (mode) {
+  case Q9Mode::Homophone:
+    return Q9Action::CommitShowCode;
+  case Q9Mode::OpenClose:
+    return Q9Action::CommitBracket;
+  case Q9Mode::HomoSelect:
+    return Q9Action::ShowHomophones;
+  default:
+    return Q9Action::CommitWord;
+  }
+}
+
+// Mode after the homophone key. Modes without a Homo twin (bracket pairs,
+// homophones, phrase input) stay as they are: arming them would lose what
+// the selection is for.
+constexpr Q9Mode homoToggled(Q9Mode mode) {
+  switch (mode) {
+  case Q9Mode::Idle:
+    return Q9Mode::HomoIdle;
+  case Q9Mode::Input:
+    return Q9Mode::HomoInput;
+  case Q9Mode::Select:
+    return Q9Mode::HomoSelect;
+  case Q9Mode::HomoIdle:
+    return Q9Mode::Idle;
+  case Q9Mode::HomoInput:
+    return Q9Mode::Input;
+  case Q9Mode::HomoSelect:
+    return Q9Mode::Select;
+  default:
+    return mode;
+  }
+}
+
+// Mirrors the branches of the C# pressKey() / command handlers
+constexpr TransitionTable buildTransitions() {
+  TransitionTable table{};
+  for (size_t m = 0; m < kModeCount; ++m) {
+    Q9Mode mode = (Q9Mode)m;
+    bool selecting = isSelectMode(mode);
+    std::array<Q9Action, kInputCount> &row = table[m];
+
+    for (int digit = 0; digit <= 9; ++digit) {
+      if (!selecting) {
+        row[digit] = Q9Action::TypeDigit;
+      } else {
+        row[digit] = digit == 0 ? Q9Action::NextPage : selectAction(mode);
+      }
+    }
+    row[(size_t)Q9Key::Cancel] = Q9Action::Cancel;
+    row[(size_t)Q9Key::Relate] = Q9Action::Relate;
+    row[(size_t)Q9Key::Homo] =
+        homoToggled(mode) != mode ? Q9Action::ToggleHomo : Q9Action::None;
+    row[(size_t)Q9Key::OpenClose] = Q9Action::OpenClose;
+    row[(size_t)Q9Key::Shortcut] =
+        selecting ? Q9Action::None : Q9Action::Shortcut;
+    row[(size_t)Q9Key::NextPage] =
+        selecting ? Q9Action::NextPage : Q9Action::None;
+    row[(size_t)Q9Key::PrevPage] =
+        selecting ? Q9Action::PrevPage : Q9Action::None;
+    row[(size_t)Q9Key::Phrase] =
+        selecting ? Q9Action::None : Q9Action::StartPhrase;
+    row[(size_t)Q9Key::Wildcard] =
+        selecting ? Q9Action::None : Q9Action::TypeWildcard;
+
+    if (mode == Q9Mode::Phrase) {
+      // Only digits, cancel and the phrase key mean anything mid-phrase
+      // (Homo has no twin here either)
+      row[(size_t)Q9Key::Relate] = Q9Action::None;
+      row[(size_t)Q9Key::OpenClose] = Q9Action::None;
+      row[(size_t)Q9Key::Shortcut] = Q9Action::None;
+      row[(size_t)Q9Key::Phrase] = Q9Action::ShowPhrases;
+      row[(size_t)Q9Key::Wildcard] = Q9Action::None;
+    }
+  }
+  return table;
+}
+
+constexpr TransitionTable kTransitions = buildTransitions();
+
+constexpr Q9Mode homoDisarmed(Q9Mode mode) {
+  return isHomoArmed(mode) ? homoToggled(mode) : mode;
+}
+
+// Every table entry must be reachable only in modes where its preconditions
+// hold: typing only outside selection, choosing and paging only inside it,
+// and the special commits only in their own mode.
+constexpr bool transitionsConsistent() {
+  for (size_t m = 0; m < kModeCount; ++m) {
+    Q9Mode mode = (Q9Mode)m;
+    for (size_t input = 0; input < kInputCount; ++input) {
+      switch (kTransitions[m][input]) {
+      case Q9Action::TypeDigit:
+      case Q9Action::Shortcut:
+        if (isSelectMode(mode))
+          return false;
+        break;
+      case Q9Action::TypeWildcard:
+        // Phrase input follows exact codes only
+        if (isSelectMode(mode) || mode == Q9Mode::Phrase)
+          return false;
+        break;
+      case Q9Action::NextPage:
+      case Q9Action::PrevPage:
+      case Q9Action::CommitWord:
+        if (!isSelectMode(mode))
+          return false;
+        break;
+      case Q9Action::CommitShowCode:
+        if (mode != Q9Mode::Homophone)
+          return false;
+        break;
+      case Q9Action::CommitBracket:
+        if (mode != Q9Mode::OpenClose)
+          return false;
+        break;
+      case Q9Action::ShowHomophones:
+        if (mode != Q9Mode::HomoSelect)
+          return false;
+        break;
+      case Q9Action::StartPhrase:
+        if (isSelectMode(mode) || mode == Q9Mode::Phrase)
+          return false;
+        break;
+      case Q9Action::ShowPhrases:
+        if (mode != Q9Mode::Phrase)
+          return false;
+        break;
+      default:
+        break;
+      }
+    }
+    // Where the homophone key works, it never enters or leaves selection,
+    // only ever flips the armed state, and pressing it again goes back
+    Q9Mode toggled = homoToggled(mode);
+    if (kTransitions[m][(size_t)Q9Key::Homo] == Q9Action::ToggleHomo &&
+        (isSelectMode(toggled) != isSelectMode(mode) ||
+         isHomoArmed(toggled) == isHomoArmed(mode) ||
+         homoToggled(toggled) != mode))
+      return false;
+  }
+  return true;
+}
+
+static_assert(transitionsConsistent(),
+              "Q9 transition table reaches an invalid mode/action pair");
+static_assert(kTransitions[(size_t)Q9Mode::Idle][0] == Q9Action::TypeDigit,
+              "Key 0 ends a code early outside selection");
+static_assert(kTransitions[(size_t)Q9Mode::Select][0] == Q9Action::NextPage,
+              "Key 0 pages while choosing");
+static_assert(kTransitions[(size_t)Q9Mode::Phrase][0] == Q9Action::TypeDigit,
+              "Key 0 ends a code early in phrase input too");
+static_assert(kTransitions[(size_t)Q9Mode::OpenClose][(size_t)Q9Key::Homo] ==
+                  Q9Action::None,
+              "Bracket pairs never leave OpenClose, so they are never "
+              "committed as words");
+
+} // namespace q9
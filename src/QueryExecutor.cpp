@@ -0,0 +1,14 @@
+#include "QueryExecutor.h"
+
+QueryExecutor::QueryExecutor(fcitx::EventLoop *loop) {
+  // One worker: submissions run in order and never compete for the disk
+  pool_.setMaxThreadCount(1);
+  pool_.setExpiryTimeout(-1);
+  dispatcher_.attach(loop);
+}
+
+QueryExecutor::~QueryExecutor() {
+  pool_.clear();
+  pool_.waitForDone();
+  dispatcher_.detach();
+}
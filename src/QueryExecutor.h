@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QThreadPool>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fcitx-utils/event.h>
+#include <fcitx-utils/eventdispatcher.h>
+#include <functional>
+#include <memory>
+
+// Runs blocking work (opening the database, building indexes, reading
+// config files) on one background thread, and hands each result back on
+// the fcitx event loop so callers never touch engine state off-thread.
+//
+// Work is submitted on a channel. A newer submit() on the same channel
+// supersedes the older ones: work that has not started yet is skipped, and
+// results that arrive late are dropped, so only the latest result is ever
+// applied.
+class QueryExecutor {
+public:
+  enum class Channel { Database, Config, Usage, Journal, Overlay, Count };
+
+  explicit QueryExecutor(fcitx::EventLoop *loop);
+  // Waits for running work; pending results are dropped
+  ~QueryExecutor();
+  QueryExecutor(const QueryExecutor &) = delete;
+  QueryExecutor &operator=(const QueryExecutor &) = delete;
+
+  template <typename T>
+  void submit(Channel channel, std::function<T()> work,
+              std::function<void(T)> done) {
+    std::atomic<uint64_t> &generation = generations_[(size_t)channel];
+    uint64_t ticket = ++generation;
+    ++pending_[(size_t)channel];
+    pool_.start([this, &generation, ticket, channel, work = std::move(work),
+                 done = std::move(done)]() mutable {
+      if (generation.load() != ticket) {
+        finish(channel);
+        return;
+      }
+      auto result = std::make_shared<T>(work());
+      dispatcher_.schedule([this, &generation, ticket, channel, result,
+                            done = std::move(done)]() {
+        finish(channel);
+        if (generation.load() == ticket) {
+          done(std::move(*result));
+        }
+      });
+    });
+  }
+
+  // Drop whatever is queued or in flight on a channel
+  void cancel(Channel channel) { ++generations_[(size_t)channel]; }
+  // True while work on the channel has not been delivered or dropped yet
+  bool busy(Channel channel) const { return pending_[(size_t)channel] > 0; }
+  // Block until the worker has run everything queued so far
+  void waitForIdle() { pool_.waitForDone(); }
+
+private:
+  void finish(Channel channel) { --pending_[(size_t)channel]; }
+
+  QThreadPool pool_;
+  fcitx::EventDispatcher dispatcher_;
+  std::array<std::atomic<uint64_t>, (size_t)Channel::Count> generations_{};
+  std::array<std::atomic<int>, (size_t)Channel::Count> pending_{};
+};
@@ -0,0 +1,83 @@
+#include "RelateIndex.h"
+#include <iostream>
+#include <string_view>
+
+void RelateIndex::encode(std::vector<uint8_t> &out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+// Q9Core.cs: "SELECT candidates FROM related_candidates_table WHERE
+// character='{word}'" with " " as splitChar, i.e. candidates are space
+// separated. Split every row once here; candidate phrases become symbols.
+bool RelateIndex::load(sqlite3 *db, SymbolTable &symbols) {
+  offsets_.clear();
+  bytes_.clear();
+
+  sqlite3_stmt *stmt;
+  const char *sql =
+      "SELECT character, candidates FROM related_candidates_table";
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "[RelateIndex] load: prepare failed: " << sqlite3_errmsg(db)
+              << std::endl;
+    return false;
+  }
+
+  // (character symbol, encoded run) in table order; the runs are laid out
+  // by symbol id afterwards
+  std::vector<std::pair<uint32_t, std::vector<uint8_t>>> rows;
+  std::vector<uint32_t> ids;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const char *ch =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    const char *text =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    if (!ch || !text)
+      continue;
+
+    uint32_t symbol = symbols.intern(ch);
+    ids.clear();
+    std::string_view s(text);
+    size_t start = 0;
+    while (start < s.size()) {
+      size_t pos = s.find(' ', start);
+      if (pos == std::string_view::npos)
+        pos = s.size();
+      if (pos > start)
+        ids.push_back(symbols.intern(s.substr(start, pos - start)));
+      start = pos + 1;
+    }
+    if (ids.empty())
+      continue;
+
+    std::vector<uint8_t> run;
+    encode(run, ids.size());
+    for (uint32_t id : ids)
+      encode(run, id);
+    rows.emplace_back(symbol, std::move(run));
+  }
+  sqlite3_finalize(stmt);
+
+  // Keep the first row per character, like the single-row lookup did
+  std::vector<const std::vector<uint8_t> *> runOf(symbols.size(), nullptr);
+  size_t total = 0;
+  for (const auto &[symbol, run] : rows) {
+    if (!runOf[symbol]) {
+      runOf[symbol] = &run;
+      total += run.size();
+    }
+  }
+
+  offsets_.reserve(runOf.size() + 1);
+  bytes_.reserve(total);
+  for (const auto *run : runOf) {
+    offsets_.push_back(bytes_.size());
+    if (run)
+      bytes_.insert(bytes_.end(), run->begin(), run->end());
+  }
+  offsets_.push_back(bytes_.size());
+  return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "SymbolTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <sqlite3.h>
+#include <vector>
+
+// Related candidates (related_candidates_table) held in memory: for every
+// character symbol a run of varint-encoded candidate symbol ids in one
+// byte array, prefixed with the candidate count.
+class RelateIndex {
+public:
+  // Non-owning view over one character's candidates; iterating decodes the
+  // ids in place, so neither building nor walking a List allocates.
+  class List {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = uint32_t;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const uint32_t *;
+      using reference = uint32_t;
+
+      iterator() = default;
+      explicit iterator(const uint8_t *p) : p_(p) {}
+      uint32_t operator*() const {
+        const uint8_t *p = p_;
+        return decode(p);
+      }
+      iterator &operator++() {
+        decode(p_);
+        return *this;
+      }
+      bool operator==(const iterator &o) const { return p_ == o.p_; }
+
+    private:
+      const uint8_t *p_ = nullptr;
+    };
+
+    List() = default;
+    List(const uint8_t *begin, const uint8_t *end, size_t count)
+        : begin_(begin), end_(end), count_(count) {}
+
+    iterator begin() const { return iterator(begin_); }
+    iterator end() const { return iterator(end_); }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+  private:
+    const uint8_t *begin_ = nullptr;
+    const uint8_t *end_ = nullptr;
+    size_t count_ = 0;
+  };
+
+  bool load(sqlite3 *db, SymbolTable &symbols);
+
+  List find(uint32_t symbol) const {
+    // Not symbol + 1: that wraps to 0 for SymbolTable::kNone
+    if (offsets_.empty() || symbol >= offsets_.size() - 1)
+      return List();
+    const uint8_t *p = bytes_.data() + offsets_[symbol];
+    const uint8_t *end = bytes_.data() + offsets_[symbol + 1];
+    if (p == end)
+      return List();
+    size_t count = decode(p);
+    return List(p, end, count);
+  }
+
+  size_t memoryUsage() const {
+    return bytes_.capacity() + offsets_.capacity() * sizeof(uint32_t);
+  }
+
+  static uint32_t decode(const uint8_t *&p) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      uint8_t b = *p++;
+      value |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        return value;
+    }
+  }
+
+private:
+  static void encode(std::vector<uint8_t> &out, uint32_t value);
+
+  std::vector<uint32_t> offsets_; // symbol id -> range in bytes_
+  std::vector<uint8_t> bytes_;
+};
@@ -0,0 +1,73 @@
+#include "SymbolTable.h"
+
+void SymbolTable::reset(const Lexicon &lexicon) {
+  lexicon_ = &lexicon;
+  base_ = lexicon.symbolCount();
+  extra_.clear();
+  extraOffsets_.assign(1, 0);
+
+  size_t capacity = 16;
+  while (capacity < (size_t)base_ * 2)
+    capacity *= 2;
+  slots_.assign(capacity, kNone);
+  for (uint32_t id = 0; id < base_; ++id) {
+    insertSlot(id);
+  }
+}
+
+// FNV-1a
+uint32_t SymbolTable::hash(std::string_view str) {
+  uint32_t h = 2166136261u;
+  for (unsigned char c : str) {
+    h = (h ^ c) * 16777619u;
+  }
+  return h;
+}
+
+uint32_t SymbolTable::find(std::string_view str) const {
+  if (slots_.empty())
+    return kNone;
+  size_t mask = slots_.size() - 1;
+  for (size_t i = hash(str) & mask;; i = (i + 1) & mask) {
+    uint32_t id = slots_[i];
+    if (id == kNone || this->str(id) == str)
+      return id;
+  }
+}
+
+uint32_t SymbolTable::intern(std::string_view str) {
+  uint32_t id = find(str);
+  if (id != kNone)
+    return id;
+
+  id = size();
+  extra_.append(str);
+  extraOffsets_.push_back(extra_.size());
+  if ((size_t)size() * 2 > slots_.size()) {
+    grow();
+  } else {
+    insertSlot(id);
+  }
+  return id;
+}
+
+void SymbolTable::insertSlot(uint32_t id) {
+  size_t mask = slots_.size() - 1;
+  size_t i = hash(str(id)) & mask;
+  while (slots_[i] != kNone) {
+    i = (i + 1) & mask;
+  }
+  slots_[i] = id;
+}
+
+void SymbolTable::grow() {
+  slots_.assign(slots_.empty() ? 16 : slots_.size() * 2, kNone);
+  for (uint32_t id = 0; id < size(); ++id) {
+    insertSlot(id);
+  }
+}
+
+size_t SymbolTable::memoryUsage() const {
+  return extra_.capacity() +
+         (extraOffsets_.capacity() + slots_.capacity()) * sizeof(uint32_t);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Lexicon.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Maps short UTF-8 strings (characters, phrases) to dense 32-bit ids.
+// Ids below lexicon.symbolCount() are the lexicon's own symbol ids and are
+// read straight from the mapped file; strings that only appear in other
+// tables are appended after them into one arena.
+//
+// Views returned by str() for appended symbols stay valid until the next
+// intern() call.
+class SymbolTable {
+public:
+  static constexpr uint32_t kNone = Lexicon::kNoSymbol;
+
+  // Start over with the symbols of a lexicon (which must outlive the table)
+  void reset(const Lexicon &lexicon);
+
+  uint32_t find(std::string_view str) const;
+  uint32_t intern(std::string_view str);
+
+  std::string_view str(uint32_t id) const {
+    if (id < base_)
+      return lexicon_->symbol(id);
+    id -= base_;
+    if (id + 1 < extraOffsets_.size())
+      return std::string_view(extra_.data() + extraOffsets_[id],
+                              extraOffsets_[id + 1] - extraOffsets_[id]);
+    return std::string_view();
+  }
+
+  uint32_t size() const { return base_ + extraOffsets_.size() - 1; }
+  size_t memoryUsage() const;
+
+private:
+  static uint32_t hash(std::string_view str);
+  void insertSlot(uint32_t id);
+  void grow();
+
+  const Lexicon *lexicon_ = nullptr;
+  uint32_t base_ = 0;
+  std::string extra_;                     // UTF-8 of appended symbols
+  std::vector<uint32_t> extraOffsets_{0}; // Range of each in extra_
+  std::vector<uint32_t> slots_;           // Open-addressed id hash table
+};
@@ -0,0 +1,81 @@
+#include "Transcoder.h"
+#include "Utf8.h"
+#include <algorithm>
+#include <iostream>
+
+bool Transcoder::load(sqlite3 *db) {
+  pairs_.clear();
+  sqlite3_stmt *stmt;
+  const char *sql = "SELECT traditional, simplified FROM ts_chinese_table";
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) {
+    std::cerr << "[Transcoder] load: prepare failed: " << sqlite3_errmsg(db)
+              << std::endl;
+    return false;
+  }
+
+  size_t skipped = 0;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const char *t =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+    const char *s =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    if (!t || !s)
+      continue;
+    std::string_view trad(t), simp(s);
+    size_t ti = 0, si = 0;
+    char32_t from = utf8::decode(trad, ti);
+    char32_t to = utf8::decode(simp, si);
+    // Only single-character mappings are meaningful per glyph
+    if (ti != trad.size() || si != simp.size()) {
+      ++skipped;
+      continue;
+    }
+    if (from != to)
+      pairs_.push_back({from, to});
+  }
+  sqlite3_finalize(stmt);
+
+  // Sort and keep the first row per traditional character, like the
+  // "LIMIT 1" of the per-character query this replaces.
+  std::stable_sort(pairs_.begin(), pairs_.end(),
+                   [](const Pair &a, const Pair &b) {
+                     return a.traditional < b.traditional;
+                   });
+  pairs_.erase(std::unique(pairs_.begin(), pairs_.end(),
+                           [](const Pair &a, const Pair &b) {
+                             return a.traditional == b.traditional;
+                           }),
+               pairs_.end());
+  pairs_.shrink_to_fit();
+  minTraditional_ = pairs_.empty() ? 0 : pairs_.front().traditional;
+
+  std::cerr << "[Transcoder] loaded " << pairs_.size() << " mappings ("
+            << skipped << " multi-character rows skipped)" << std::endl;
+  return true;
+}
+
+char32_t Transcoder::map(char32_t cp) const {
+  if (cp < minTraditional_)
+    return cp;
+  auto it = std::lower_bound(
+      pairs_.begin(), pairs_.end(), cp,
+      [](const Pair &p, char32_t v) { return p.traditional < v; });
+  if (it != pairs_.end() && it->traditional == cp)
+    return it->simplified;
+  return cp;
+}
+
+void Transcoder::convert(std::string_view input, std::string &output) const {
+  size_t i = 0;
+  while (i < input.size()) {
+    size_t start = i;
+    char32_t cp = utf8::decode(input, i);
+    char32_t mapped = map(cp);
+    if (mapped == cp) {
+      // Copy the original bytes so invalid sequences pass through untouched
+      output.append(input.data() + start, i - start);
+    } else {
+      utf8::append(output, mapped);
+    }
+  }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <sqlite3.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Traditional -> Simplified conversion held entirely in memory: one sorted
+// array of codepoint pairs loaded from ts_chinese_table.
+class Transcoder {
+public:
+  bool load(sqlite3 *db);
+  bool empty() const { return pairs_.empty(); }
+
+  // Simplified form of cp, or cp itself when it has none
+  char32_t map(char32_t cp) const;
+
+  // Append the simplified form of input to output. Does not allocate once
+  // output has enough capacity.
+  void convert(std::string_view input, std::string &output) const;
+
+private:
+  struct Pair {
+    char32_t traditional;
+    char32_t simplified;
+  };
+  std::vector<Pair> pairs_;
+  char32_t minTraditional_ = 0;
+};
@@ -0,0 +1,314 @@
+#include "UsageRanker.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <iostream>
+#include <string_view>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+// 2^(1/1000): a selection counts half as much 1000 selections later
+constexpr float kGrowth = 1.000693f;
+// Scores below this fraction of a fresh selection (four half-lives) no
+// longer reorder anything and are dropped by compaction
+constexpr float kForget = 1.0f / 16;
+// Rescale before the weights get anywhere near float overflow
+constexpr float kRenormalizeAt = 1e12f;
+// Journal lines that trigger a compaction
+constexpr size_t kCompactAfter = 4096;
+// A dominant candidate has at least this many recent selections (in fresh
+// selection weights), and this many times the runner-up's score
+constexpr float kDominantSelections = 8;
+constexpr float kDominance = 4;
+
+} // namespace
+
+// Whatever is still buffered is written on the way out
+UsageRanker::~UsageRanker() {
+  if (!path_.empty() && !buffer_.empty()) {
+    appendJournal(path_, std::move(buffer_));
+  }
+}
+
+UsageRanker::Journal UsageRanker::load(const std::string &path) {
+  Journal journal;
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return journal;
+  std::string data;
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    data.append(buf, n);
+  }
+  fclose(f);
+
+  // Replay in order; only complete lines count
+  std::unordered_map<std::string, float> scores;
+  float scale = 1;
+  size_t end;
+  for (size_t start = 0; (end = data.find('\n', start)) != std::string::npos;
+       start = end + 1) {
+    std::string_view line(data.data() + start, end - start);
+    ++journal.lines;
+    size_t tab = line.find('\t');
+    if (tab == std::string_view::npos) {
+      if (line.empty())
+        continue;
+      scores[std::string(line)] += scale;
+      scale *= kGrowth;
+      if (scale > kRenormalizeAt) {
+        for (auto &entry : scores) {
+          entry.second /= scale;
+        }
+        scale = 1;
+      }
+    } else if (tab > 0) {
+      float value = 0;
+      auto result =
+          std::from_chars(line.data() + tab + 1, line.end(), value);
+      if (result.ec == std::errc()) {
+        scores[std::string(line.substr(0, tab))] += value * scale;
+      }
+    }
+  }
+
+  for (const auto &[word, score] : scores) {
+    if (score / scale >= kForget) {
+      journal.scores.emplace_back(word, score / scale);
+    }
+  }
+  return journal;
+}
+
+void UsageRanker::attach(const SymbolTable &symbols, const Journal &journal,
+                         const std::string &path) {
+  symbols_ = &symbols;
+  scores_.assign(symbols.size(), 0);
+  scale_ = 1;
+  for (const auto &[word, score] : journal.scores) {
+    uint32_t id = symbols.find(word);
+    if (id < scores_.size()) {
+      scores_[id] += score;
+    }
+  }
+  journalLines_ = journal.lines;
+  path_ = path;
+  buffer_.clear();
+}
+
+float UsageRanker::threshold() const { return scale_ * kForget; }
+
+void UsageRanker::rank(std::vector<uint32_t> &ids) const {
+  if (!enabled_ || scores_.empty())
+    return;
+  float min = threshold();
+  promoted_.clear();
+  for (size_t i = 0; i < ids.size(); ++i) {
+    uint32_t id = ids[i];
+    if (id < scores_.size() && scores_[id] >= min) {
+      promoted_.push_back({scores_[id], (uint32_t)i, id});
+    }
+  }
+  if (promoted_.empty())
+    return;
+
+  std::sort(promoted_.begin(), promoted_.end(),
+            [](const Promoted &a, const Promoted &b) {
+              return a.score != b.score ? a.score > b.score : a.pos < b.pos;
+            });
+  // Slide the others to the back, keeping their order
+  size_t out = ids.size();
+  for (size_t i = ids.size(); i-- > 0;) {
+    uint32_t id = ids[i];
+    if (id >= scores_.size() || scores_[id] < min) {
+      ids[--out] = id;
+    }
+  }
+  for (size_t i = 0; i < promoted_.size(); ++i) {
+    ids[i] = promoted_[i].id;
+  }
+}
+
+bool UsageRanker::dominates(std::span<const uint32_t> ids) const {
+  if (!enabled_ || ids.empty() || ids[0] >= scores_.size())
+    return false;
+  float top = scores_[ids[0]];
+  float next = 0;
+  if (ids.size() > 1 && ids[1] < scores_.size()) {
+    next = scores_[ids[1]];
+  }
+  return top >= scale_ * kDominantSelections && top >= next * kDominance;
+}
+
+void UsageRanker::record(uint32_t symbol) {
+  if (!enabled_ || !symbols_ || symbol >= symbols_->size())
+    return;
+  if (symbol >= scores_.size()) {
+    scores_.resize(symbols_->size(), 0);
+  }
+  scores_[symbol] += scale_;
+  scale_ *= kGrowth;
+  if (scale_ > kRenormalizeAt) {
+    renormalize();
+  }
+  ++selections_;
+  lastSelection_ = symbol;
+
+  if (!path_.empty()) {
+    appendLine(buffer_, symbol);
+    ++journalLines_;
+  }
+  // Also replayed onto the snapshot once it is in place
+  if (compacting_) {
+    pending_.push_back(symbol);
+  }
+}
+
+void UsageRanker::renormalize() {
+  for (float &score : scores_) {
+    score /= scale_;
+  }
+  scale_ = 1;
+}
+
+void UsageRanker::appendLine(std::string &out, uint32_t symbol) const {
+  out += symbols_->str(symbol);
+  out += '\n';
+}
+
+bool UsageRanker::appendDue() const {
+  return !buffer_.empty() && !appending_ && !compacting_;
+}
+
+std::string UsageRanker::takeJournal() {
+  appending_ = true;
+  std::string data;
+  data.swap(buffer_);
+  return data;
+}
+
+// O_APPEND, so a crash can only tear the last line. A short write() is
+// carried on from where it stopped.
+UsageRanker::Batch UsageRanker::appendJournal(const std::string &path,
+                                              std::string data) {
+  Batch batch{std::move(data)};
+  int fd =
+      ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "[UsageRanker] can't open journal " << path << std::endl;
+    return batch;
+  }
+  while (batch.written < batch.data.size()) {
+    ssize_t n = ::write(fd, batch.data.data() + batch.written,
+                        batch.data.size() - batch.written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    batch.written += n;
+  }
+  close(fd);
+  if (batch.written < batch.data.size()) {
+    std::cerr << "[UsageRanker] journal write failed after "
+              << batch.written << " of " << batch.data.size() << " bytes"
+              << std::endl;
+  }
+  return batch;
+}
+
+// The unwritten tail goes back in front of the buffer, so the next batch
+// finishes a line this one tore and journalLines_ stays right
+bool UsageRanker::finishAppend(Batch batch) {
+  appending_ = false;
+  if (batch.written < batch.data.size()) {
+    buffer_.insert(0, batch.data, batch.written);
+    return false;
+  }
+  ++appends_;
+  return true;
+}
+
+bool UsageRanker::compactionDue() const {
+  return !path_.empty() && !compacting_ && !appending_ &&
+         journalLines_ >= kCompactAfter;
+}
+
+std::string UsageRanker::snapshot() {
+  std::string data;
+  float min = threshold();
+  char value[32];
+  snapshotLines_ = 0;
+  for (uint32_t id = 0; id < scores_.size(); ++id) {
+    if (scores_[id] < min)
+      continue;
+    data += symbols_->str(id);
+    data += '\t';
+    auto result =
+        std::to_chars(value, value + sizeof(value), scores_[id] / scale_);
+    data.append(value, result.ptr);
+    data += '\n';
+    ++snapshotLines_;
+  }
+  compacting_ = true;
+  pending_.clear();
+  return data;
+}
+
+// Written next to the journal; finishCompaction() renames it into place
+bool UsageRanker::writeSnapshot(const std::string &path,
+                                const std::string &data) {
+  std::string tmpPath = path + ".tmp";
+  FILE *f = fopen(tmpPath.c_str(), "wb");
+  if (!f) {
+    std::cerr << "[UsageRanker] can't write " << tmpPath << std::endl;
+    return false;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+  ok = (fclose(f) == 0) && ok;
+  return ok;
+}
+
+bool UsageRanker::finishCompaction(bool ok) {
+  compacting_ = false;
+  std::string tmpPath = path_ + ".tmp";
+  if (ok) {
+    ok = rename(tmpPath.c_str(), path_.c_str()) == 0;
+  }
+  if (!ok) {
+    // The old journal stays; buffer_ still holds every line it lacks
+    std::cerr << "[UsageRanker] compaction of " << path_ << " failed"
+              << std::endl;
+    unlink(tmpPath.c_str());
+    pending_.clear();
+    return false;
+  }
+
+  // The snapshot covers what was buffered before it; only the selections
+  // made while it was written remain to be appended
+  buffer_.clear();
+  for (uint32_t symbol : pending_) {
+    appendLine(buffer_, symbol);
+  }
+  ++compactions_;
+  journalLines_ = snapshotLines_ + pending_.size();
+  pending_.clear();
+  return true;
+}
+
+void UsageRanker::dumpStats(std::ostream &out) const {
+  size_t ranked = 0;
+  for (float score : scores_) {
+    ranked += score >= threshold();
+  }
+  out << "[UsageRanker] " << (enabled_ ? "on" : "off") << ", " << ranked
+      << " symbols ranked (" << scores_.size() * sizeof(float)
+      << " bytes), " << selections_ << " selections, " << journalLines_
+      << " journal lines (" << appends_ << " appends), " << compactions_
+      << " compactions" << std::endl;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "SymbolTable.h"
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Per-user candidate order from decayed selection counts. Each selection
+// adds a weight that grows geometrically with the number of selections,
+// which decays every older one without touching it; scores are brought back
+// down when the weight gets large. Symbols not chosen for a few half-lives
+// fall back to the lexicon order.
+//
+// Selections are appended to a journal, one "<word>\n" line each. record()
+// only buffers the line; the buffer is appended on a worker, a batch at a
+// time. Compaction rewrites the journal as one "<word>\t<score>\n" line per
+// symbol through a temporary file and rename(), so a crash leaves either the
+// old or the new journal whole; a torn last line is ignored when loading.
+//
+// Only used from the fcitx thread, except load(), appendJournal() and
+// writeSnapshot().
+class UsageRanker {
+public:
+  // Scores read from a journal, scaled so a new selection weighs 1
+  struct Journal {
+    std::vector<std::pair<std::string, float>> scores;
+    size_t lines = 0;
+  };
+
+  ~UsageRanker();
+
+  // Parse a journal; a missing file is an empty one. Safe on a worker.
+  static Journal load(const std::string &path);
+  // Bind to the database's symbols, merge what load() read, and start
+  // appending to path. Until then rank() and record() do nothing.
+  void attach(const SymbolTable &symbols, const Journal &journal,
+              const std::string &path);
+
+  void setEnabled(bool enabled) { enabled_ = enabled; }
+
+  // Move recently chosen symbols to the front, best score first; the rest
+  // keep their order. Allocation-free once warmed up.
+  void rank(std::vector<uint32_t> &ids) const;
+  // Whether ids, as ordered by rank(), lead with a symbol chosen so much
+  // more than the rest that asking would be a wasted keystroke
+  bool dominates(std::span<const uint32_t> ids) const;
+  // Count a selection and buffer its journal line. Symbols interned after
+  // attach() (by the user overlay) are taken on as they are first chosen.
+  void record(uint32_t symbol);
+  // Bumped by every selection record() counts, each of which may reorder
+  // the lists the symbol is in
+  uint64_t generation() const { return selections_; }
+  // The symbol of the latest such selection
+  uint32_t lastSelection() const { return lastSelection_; }
+
+  // A batch of journal lines and how much of it reached the file
+  struct Batch {
+    std::string data;
+    size_t written = 0;
+  };
+
+  // Appending: takeJournal() on the fcitx thread, appendJournal() on a
+  // worker, then finishAppend() back on the fcitx thread, which puts what
+  // was not written back in front of the buffer and returns false. One
+  // batch at a time, and none while compacting.
+  bool appendDue() const;
+  std::string takeJournal();
+  static Batch appendJournal(const std::string &path, std::string data);
+  bool finishAppend(Batch batch);
+
+  // Compaction: snapshot() on the fcitx thread, writeSnapshot() on a
+  // worker, then finishCompaction() back on the fcitx thread, false if the
+  // old journal was kept
+  bool compactionDue() const;
+  std::string snapshot();
+  static bool writeSnapshot(const std::string &path, const std::string &data);
+  bool finishCompaction(bool ok);
+
+  void dumpStats(std::ostream &out) const;
+
+private:
+  struct Promoted {
+    float score;
+    uint32_t pos;
+    uint32_t id;
+  };
+
+  float threshold() const;
+  void renormalize();
+  void appendLine(std::string &out, uint32_t symbol) const;
+
+  const SymbolTable *symbols_ = nullptr;
+  std::vector<float> scores_; // By symbol id, in units of scale_
+  float scale_ = 1;           // Weight of the next selection
+  bool enabled_ = true;
+  mutable std::vector<Promoted> promoted_; // rank() scratch
+
+  std::string path_;
+  std::string buffer_;            // Journal lines not handed to a worker
+  bool appending_ = false;        // A batch is being appended
+  size_t journalLines_ = 0;       // Lines in the journal file and buffer_
+  size_t snapshotLines_ = 0;      // Lines in the snapshot being written
+  bool compacting_ = false;       // A snapshot is being written
+  std::vector<uint32_t> pending_; // Selections since the snapshot
+
+  uint64_t selections_ = 0;
+  uint32_t lastSelection_ = SymbolTable::kNone;
+  uint64_t appends_ = 0;
+  uint64_t compactions_ = 0;
+};
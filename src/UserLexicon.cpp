@@ -0,0 +1,134 @@
+#include "UserLexicon.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+UserLexicon::Edits UserLexicon::load(const std::string &path) {
+  Edits edits;
+  std::ifstream in(path);
+  if (!in)
+    return edits;
+
+  std::string line;
+  for (size_t number = 1; std::getline(in, line); ++number) {
+    std::string_view rest(line);
+    auto nextField = [&rest]() {
+      size_t begin = rest.find_first_not_of(" \t\r");
+      if (begin == std::string_view::npos) {
+        rest = {};
+        return std::string_view();
+      }
+      size_t end = std::min(rest.find_first_of(" \t\r", begin), rest.size());
+      std::string_view field = rest.substr(begin, end - begin);
+      rest.remove_prefix(end);
+      return field;
+    };
+
+    std::string_view field = nextField();
+    if (field.empty() || field[0] == '#')
+      continue;
+    int code = 0;
+    auto result = std::from_chars(field.data(), field.end(), code);
+    if (result.ec != std::errc() || result.ptr != field.end() || code <= 0 ||
+        (uint32_t)code >= Lexicon::kCodeCount) {
+      std::cerr << "[UserLexicon] " << path << ":" << number
+                << ": not a code: '" << field << "'" << std::endl;
+      continue;
+    }
+
+    // Several lines for one code add up
+    Edit &edit = edits[code];
+    while (!(field = nextField()).empty()) {
+      if (field[0] == '-') {
+        if (field.size() > 1) {
+          edit.hidden.emplace_back(field.substr(1));
+        }
+      } else {
+        edit.front.emplace_back(field);
+      }
+    }
+  }
+  return edits;
+}
+
+std::vector<int> UserLexicon::apply(const Edits &edits,
+                                    const Lexicon &lexicon,
+                                    SymbolTable &symbols) {
+  std::vector<int> changed;
+  for (const auto &[code, edit] : edits) {
+    auto old = edits_.find(code);
+    if (old == edits_.end() || old->second != edit) {
+      changed.push_back(code);
+    }
+  }
+  for (const auto &[code, edit] : edits_) {
+    if (edits.find(code) == edits.end()) {
+      changed.push_back(code);
+    }
+  }
+  if (changed.empty())
+    return changed;
+
+  edits_ = edits;
+  ++generation_;
+  if (edits_.empty()) {
+    // Back to the system lexicon alone
+    codes_.clear();
+    codes_.shrink_to_fit();
+    return changed;
+  }
+
+  codes_.resize(Lexicon::kCodeCount);
+  for (int code : changed) {
+    auto edit = edits_.find(code);
+    if (edit != edits_.end()) {
+      merge(code, edit->second, lexicon, symbols);
+    } else {
+      codes_[code] = Merged();
+    }
+  }
+  return changed;
+}
+
+void UserLexicon::merge(int code, const Edit &edit, const Lexicon &lexicon,
+                        SymbolTable &symbols) {
+  std::vector<uint32_t> hidden;
+  for (const std::string &word : edit.hidden) {
+    uint32_t id = symbols.find(word);
+    if (id != SymbolTable::kNone) {
+      hidden.push_back(id);
+    }
+  }
+  auto listed = [](const std::vector<uint32_t> &ids, uint32_t id) {
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+  };
+
+  Merged &merged = codes_[code];
+  merged.edited = true;
+  merged.ids.clear();
+  for (const std::string &word : edit.front) {
+    uint32_t id = symbols.intern(word);
+    if (!listed(hidden, id) && !listed(merged.ids, id)) {
+      merged.ids.push_back(id);
+    }
+  }
+  size_t front = merged.ids.size();
+  for (uint32_t id : lexicon.words(code).ids()) {
+    if (!listed(hidden, id) &&
+        std::find(merged.ids.begin(), merged.ids.begin() + front, id) ==
+            merged.ids.begin() + front) {
+      merged.ids.push_back(id);
+    }
+  }
+  merged.ids.shrink_to_fit();
+}
+
+size_t UserLexicon::memoryUsage() const {
+  size_t bytes = codes_.capacity() * sizeof(Merged);
+  for (const Merged &merged : codes_) {
+    bytes += merged.ids.capacity() * sizeof(uint32_t);
+  }
+  return bytes;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Lexicon.h"
+#include "SymbolTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// The user's own edits to the lexicon, layered over the system candidates
+// of each code. They come from overlay.txt in the user data directory, one
+// line per code:
+//
+//   1000 謝謝 你好 -嗎
+//
+// Plain words go first, in the order given, whether or not the system lists
+// them under the code; the code's other system candidates follow in their
+// usual order. A word prefixed with '-' is hidden. Lines starting with '#'
+// are comments.
+//
+// Every edited code gets a merged candidate list, built when the overlay is
+// applied; lookups of the other codes only see that there is none.
+class UserLexicon {
+public:
+  struct Edit {
+    std::vector<std::string> front;  // Words to put first, in order
+    std::vector<std::string> hidden; // Words to leave out
+    bool operator==(const Edit &) const = default;
+  };
+  using Edits = std::map<int, Edit>; // By code
+
+  // Parse an overlay file; a missing file is an empty overlay. Safe on a
+  // worker.
+  static Edits load(const std::string &path);
+
+  // Take over a new set of edits, rebuilding the merged list of every code
+  // whose edits changed (new words are interned into symbols). Returns the
+  // codes rebuilt.
+  std::vector<int> apply(const Edits &edits, const Lexicon &lexicon,
+                         SymbolTable &symbols);
+
+  // Merged candidates of a code, or nullptr when the overlay leaves the
+  // code alone. Pointers stay valid until the code is rebuilt.
+  const std::vector<uint32_t> *find(int code) const {
+    if (codes_.empty() || code < 0 || (size_t)code >= codes_.size() ||
+        !codes_[code].edited)
+      return nullptr;
+    return &codes_[code].ids;
+  }
+
+  // Bumped by every apply() that rebuilds something
+  uint64_t generation() const { return generation_; }
+  // The edits in force, by code
+  const Edits &edits() const { return edits_; }
+
+  size_t codeCount() const { return edits_.size(); }
+  size_t memoryUsage() const;
+
+private:
+  struct Merged {
+    bool edited = false;
+    std::vector<uint32_t> ids;
+  };
+  void merge(int code, const Edit &edit, const Lexicon &lexicon,
+             SymbolTable &symbols);
+
+  Edits edits_;
+  std::vector<Merged> codes_; // Empty unless some code is edited
+  uint64_t generation_ = 0;
+};
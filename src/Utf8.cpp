@@ -0,0 +1,103 @@
+#include "Utf8.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define TQ9_UTF8_X86 1
+#endif
+
+namespace utf8 {
+
+namespace {
+
+// Collects codepoint start offsets and turns consecutive starts into spans
+class SpanWriter {
+public:
+  SpanWriter(Span *out, size_t capacity) : out_(out), capacity_(capacity) {}
+
+  void start(size_t pos) {
+    if (pos != 0) {
+      if (count_ < capacity_)
+        out_[count_] = {(uint32_t)prev_, (uint32_t)(pos - prev_)};
+      ++count_;
+    }
+    prev_ = pos;
+  }
+
+  // Emit every start marked in a bitmask covering bytes [base, base + 64)
+  void starts(size_t base, uint64_t mask) {
+    while (mask) {
+      start(base + __builtin_ctzll(mask));
+      mask &= mask - 1;
+    }
+  }
+
+  size_t finish(size_t size) {
+    if (size != 0)
+      start(size);
+    return count_;
+  }
+
+private:
+  Span *out_;
+  size_t capacity_;
+  size_t count_ = 0;
+  size_t prev_ = 0;
+};
+
+inline bool isStart(unsigned char c) { return (c & 0xC0) != 0x80; }
+
+size_t splitScalar(std::string_view s, SpanWriter &writer, size_t from) {
+  for (size_t i = from; i < s.size(); ++i) {
+    if (isStart(s[i]))
+      writer.start(i);
+  }
+  return s.size();
+}
+
+#ifdef TQ9_UTF8_X86
+// Continuation bytes are 0x80..0xBF, i.e. -128..-65 as signed bytes, so
+// every byte greater than -65 starts a codepoint.
+size_t splitSse2(std::string_view s, SpanWriter &writer) {
+  const __m128i threshold = _mm_set1_epi8(-65);
+  size_t i = 0;
+  for (; i + 16 <= s.size(); i += 16) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data() + i));
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpgt_epi8(v, threshold));
+    writer.starts(i, mask);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t splitAvx2(std::string_view s,
+                                                 SpanWriter &writer) {
+  const __m256i threshold = _mm256_set1_epi8(-65);
+  size_t i = 0;
+  for (; i + 32 <= s.size(); i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s.data() + i));
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, threshold));
+    writer.starts(i, mask);
+  }
+  return i;
+}
+
+bool hasAvx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif
+
+} // namespace
+
+size_t split(std::string_view s, Span *out, size_t capacity) {
+  SpanWriter writer(out, capacity);
+  size_t done = 0;
+#ifdef TQ9_UTF8_X86
+  done = hasAvx2() ? splitAvx2(s, writer) : splitSse2(s, writer);
+#endif
+  splitScalar(s, writer, done);
+  return writer.finish(s.size());
+}
+
+} // namespace utf8
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace utf8 {
+
+// Byte length of the UTF-8 sequence starting with lead byte c. Invalid lead
+// bytes count as a single byte so callers always make progress.
+inline size_t sequenceLength(unsigned char c) {
+  if ((c & 0x80) == 0)
+    return 1;
+  if ((c & 0xE0) == 0xC0)
+    return 2;
+  if ((c & 0xF0) == 0xE0)
+    return 3;
+  if ((c & 0xF8) == 0xF0)
+    return 4;
+  return 1;
+}
+
+// Decode the codepoint at s[i] and advance i past it. Truncated or invalid
+// sequences decode to their first byte.
+inline char32_t decode(std::string_view s, size_t &i) {
+  unsigned char c = s[i];
+  size_t len = sequenceLength(c);
+  if (len == 1 || i + len > s.size()) {
+    ++i;
+    return c;
+  }
+  char32_t cp = c & (0x7F >> len);
+  for (size_t k = 1; k < len; ++k) {
+    cp = (cp << 6) | (s[i + k] & 0x3F);
+  }
+  i += len;
+  return cp;
+}
+
+inline void append(std::string &out, char32_t cp) {
+  if (cp < 0x80) {
+    out += (char)cp;
+  } else if (cp < 0x800) {
+    out += (char)(0xC0 | (cp >> 6));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += (char)(0xE0 | (cp >> 12));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else {
+    out += (char)(0xF0 | (cp >> 18));
+    out += (char)(0x80 | ((cp >> 12) & 0x3F));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+// Byte range of one codepoint inside a string
+struct Span {
+  uint32_t offset;
+  uint32_t length;
+};
+
+// Split s into codepoint spans, writing at most capacity of them to out.
+// Returns the number of codepoints in s, which may exceed capacity; s.size()
+// spans are always enough. A codepoint starts at every byte that is not a
+// continuation byte (10xxxxxx), so well-formed input splits exactly like
+// sequenceLength(); stray continuation bytes stay attached to the preceding
+// codepoint. Uses AVX2 or SSE2 when available, with a scalar fallback.
+size_t split(std::string_view s, Span *out, size_t capacity);
+
+} // namespace utf8
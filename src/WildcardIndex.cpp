@@ -0,0 +1,26 @@
+#include "WildcardIndex.h"
+#include <charconv>
+
+void WildcardIndex::build(const Lexicon &lexicon) {
+  *this = WildcardIndex();
+  for (int code = 10; code <= 999; ++code) {
+    set(code, !lexicon.words(code).empty());
+  }
+}
+
+void WildcardIndex::set(int code, bool present) {
+  if (!isTypable(code))
+    return;
+  char digits[4];
+  auto result = std::to_chars(digits, digits + sizeof(digits), code);
+  size_t length = (result.ptr - digits) - 2;
+  size_t word = code / 64;
+  uint64_t bit = uint64_t(1) << (code % 64);
+  if (((byLength_[length][word] & bit) != 0) == present)
+    return;
+  byLength_[length][word] ^= bit;
+  for (size_t pos = 0; pos < length + 2; ++pos) {
+    byDigit_[length][pos][digits[pos] - '0'][word] ^= bit;
+  }
+  present ? ++codes_ : --codes_;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Lexicon.h"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Codes by the digits they are made of, for codes typed with some digits
+// unknown. For each code length, digit position and digit there is a bitset
+// over the codes 0-1023; a pattern is the AND of the bitsets of its known
+// digits, so matching never looks at the codes themselves.
+class WildcardIndex {
+public:
+  static constexpr char kAny = '?';
+
+  // Codes Q9Logic::typeDigit() can complete: three digits, or two when the
+  // second is 0 (key 0 ends a code early, so 1-0-5 is read as 10)
+  static bool isTypable(int code) {
+    if (code >= 100 && code <= 999)
+      return code / 10 % 10 != 0;
+    return code >= 10 && code <= 90 && code % 10 == 0;
+  }
+
+  // Index every typable code that has candidates
+  void build(const Lexicon &lexicon);
+  // Add or drop one code, when its candidates change
+  void set(int code, bool present);
+
+  // Call f(code), in ascending order, for every indexed code that reads
+  // like pattern: its digits, with kAny for the unknown ones
+  template <typename F>
+  void forEachMatch(std::string_view pattern, F &&f) const {
+    if (pattern.size() < 2 || pattern.size() > 3)
+      return;
+    size_t length = pattern.size() - 2;
+    Bits bits = byLength_[length];
+    for (size_t pos = 0; pos < pattern.size(); ++pos) {
+      if (pattern[pos] == kAny)
+        continue;
+      const Bits &digit = byDigit_[length][pos][pattern[pos] - '0'];
+      for (size_t w = 0; w < kWords; ++w) {
+        bits[w] &= digit[w];
+      }
+    }
+    for (size_t w = 0; w < kWords; ++w) {
+      for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+        f((int)(w * 64 + std::countr_zero(word)));
+      }
+    }
+  }
+
+  size_t codeCount() const { return codes_; }
+  size_t memoryUsage() const { return sizeof(byLength_) + sizeof(byDigit_); }
+
+private:
+  static constexpr size_t kWords = 1024 / 64;
+  using Bits = std::array<uint64_t, kWords>;
+
+  Bits byLength_[2] = {};       // [length - 2]
+  Bits byDigit_[2][3][10] = {}; // [length - 2][position][digit]
+  size_t codes_ = 0;
+};
@@ -0,0 +1,151 @@
+// tq9-bench-dispatch: cost of choosing what a key does. Times the
+// compile-time kTransitions lookup against a reference that decides the same
+// action the way the old handlers did, by testing the mode flags one after
+// another, then the whole of Q9Logic::processKey() on a typing loop.
+//
+// Usage: tq9-bench-dispatch [dataset.db]
+//
+// Without a database only the lookups are timed.
+
+#include "Database.h"
+#include "Q9Logic.h"
+#include "Q9Transitions.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace q9;
+
+namespace {
+
+// The flags the old Q9State carried, derived from a mode
+struct Flags {
+  bool candidateMode, homoMode, afterHomoMode, openCloseMode, phraseMode;
+};
+
+Flags flagsOf(Q9Mode mode) {
+  return {isSelectMode(mode), isHomoArmed(mode), mode == Q9Mode::Homophone,
+          mode == Q9Mode::OpenClose, mode == Q9Mode::Phrase};
+}
+
+// Branch by branch, as processKey() and processCommand() used to
+[[gnu::noinline]] Q9Action branchAction(const Flags &f, Q9Key key) {
+  int k = (int)key;
+  if (k <= 9) {
+    if (!f.candidateMode)
+      return Q9Action::TypeDigit;
+    if (k == 0)
+      return Q9Action::NextPage;
+    if (f.homoMode)
+      return Q9Action::ShowHomophones;
+    if (f.openCloseMode)
+      return Q9Action::CommitBracket;
+    if (f.afterHomoMode)
+      return Q9Action::CommitShowCode;
+    return Q9Action::CommitWord;
+  }
+  switch (key) {
+  case Q9Key::Cancel:
+    return Q9Action::Cancel;
+  case Q9Key::Relate:
+    return f.phraseMode ? Q9Action::None : Q9Action::Relate;
+  case Q9Key::Homo:
+    if (f.phraseMode || f.openCloseMode || f.afterHomoMode)
+      return Q9Action::None;
+    return Q9Action::ToggleHomo;
+  case Q9Key::Shortcut:
+    return f.candidateMode || f.phraseMode ? Q9Action::None
+                                           : Q9Action::Shortcut;
+  case Q9Key::OpenClose:
+    return f.phraseMode ? Q9Action::None : Q9Action::OpenClose;
+  case Q9Key::Phrase:
+    if (f.phraseMode)
+      return Q9Action::ShowPhrases;
+    return f.candidateMode ? Q9Action::None : Q9Action::StartPhrase;
+  case Q9Key::Wildcard:
+    return f.candidateMode || f.phraseMode ? Q9Action::None
+                                           : Q9Action::TypeWildcard;
+  case Q9Key::NextPage:
+    return f.candidateMode ? Q9Action::NextPage : Q9Action::None;
+  case Q9Key::PrevPage:
+    return f.candidateMode ? Q9Action::PrevPage : Q9Action::None;
+  default:
+    return Q9Action::None;
+  }
+}
+
+[[gnu::noinline]] Q9Action tableAction(Q9Mode mode, Q9Key key) {
+  return kTransitions[(size_t)mode][(size_t)key];
+}
+
+template <typename F> double nsPer(size_t count, F &&run) {
+  auto start = std::chrono::steady_clock::now();
+  run();
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / count;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // The reference must agree with the table cell for cell
+  for (size_t m = 0; m < kModeCount; ++m) {
+    for (size_t k = 0; k < kInputCount; ++k) {
+      if (branchAction(flagsOf((Q9Mode)m), (Q9Key)k) != kTransitions[m][k]) {
+        std::cerr << "[tq9-bench-dispatch] reference disagrees at mode " << m
+                  << " key " << k << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  // Random cells, so the branch predictor cannot learn the sequence
+  constexpr size_t kSamples = 1 << 16, kRounds = 200;
+  std::mt19937 rng(9);
+  std::vector<Q9Mode> modes(kSamples);
+  std::vector<Flags> flags(kSamples);
+  std::vector<Q9Key> keys(kSamples);
+  for (size_t i = 0; i < kSamples; ++i) {
+    modes[i] = (Q9Mode)(rng() % kModeCount);
+    flags[i] = flagsOf(modes[i]);
+    keys[i] = (Q9Key)(rng() % kInputCount);
+  }
+  uint64_t sumTable = 0, sumBranch = 0;
+  double table = nsPer(kSamples * kRounds, [&] {
+    for (size_t r = 0; r < kRounds; ++r)
+      for (size_t i = 0; i < kSamples; ++i)
+        sumTable += (uint64_t)tableAction(modes[i], keys[i]);
+  });
+  double branch = nsPer(kSamples * kRounds, [&] {
+    for (size_t r = 0; r < kRounds; ++r)
+      for (size_t i = 0; i < kSamples; ++i)
+        sumBranch += (uint64_t)branchAction(flags[i], keys[i]);
+  });
+  if (sumTable != sumBranch)
+    return 1;
+  std::cout << "[tq9-bench-dispatch] table lookup " << table
+            << " ns, flag branches " << branch << " ns per key" << std::endl;
+
+  if (argc < 2)
+    return 0;
+  Database db;
+  if (!db.init(argv[1]))
+    return 1;
+  Q9Logic logic(db);
+  // Type a code, page through its candidates and back, cancel
+  const Q9Key loop[] = {Q9Key::Num4,     Q9Key::Num5,     Q9Key::Num6,
+                        Q9Key::NextPage, Q9Key::PrevPage, Q9Key::Num0,
+                        Q9Key::Cancel};
+  constexpr size_t kLoops = 200000;
+  double key = nsPer(kLoops * std::size(loop), [&] {
+    for (size_t i = 0; i < kLoops; ++i)
+      for (Q9Key k : loop)
+        logic.processCommand(k);
+  });
+  std::cout << "[tq9-bench-dispatch] processCommand " << key
+            << " ns per key (type, page, cancel)" << std::endl;
+  return 0;
+}
@@ -0,0 +1,149 @@
+// tq9-bench-utf8: throughput of utf8::split() and the Traditional ->
+// Simplified transcoder over long inputs, well-formed and not. split() is
+// first checked against the scalar rule, then timed filling spans, only
+// counting, and against the sequenceLength() walk callers used before it.
+//
+// Usage: tq9-bench-utf8 [dataset.db]
+//
+// Without a database only split() is timed.
+
+#include "Database.h"
+#include "Utf8.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kInputBytes = 4 << 20;
+constexpr int kRounds = 20;
+volatile size_t kept; // Keeps the timed results alive
+
+struct Input {
+  const char *name;
+  std::string text;
+};
+
+// Mostly CJK (3 bytes) with some ASCII and a few 4-byte codepoints, like
+// typed Chinese
+std::string chineseText(std::mt19937 &rng) {
+  std::string text;
+  while (text.size() < kInputBytes) {
+    unsigned roll = rng() % 100;
+    if (roll < 85)
+      utf8::append(text, 0x4E00 + rng() % 0x5200);
+    else if (roll < 98)
+      text += (char)(' ' + rng() % 95);
+    else
+      utf8::append(text, 0x20000 + rng() % 0xA6E0);
+  }
+  return text;
+}
+
+std::string asciiText(std::mt19937 &rng) {
+  std::string text(kInputBytes, ' ');
+  for (char &c : text)
+    c = (char)(' ' + rng() % 95);
+  return text;
+}
+
+// Any byte at all: stray continuations, bad leads, truncated sequences
+std::string randomBytes(std::mt19937 &rng) {
+  std::string text(kInputBytes, '\0');
+  for (char &c : text)
+    c = (char)rng();
+  return text;
+}
+
+// Well-formed text cut at random points, so sequences lose their tails
+std::string truncatedText(std::mt19937 &rng) {
+  std::string valid = chineseText(rng), text;
+  text.reserve(valid.size());
+  for (size_t i = 0; i < valid.size(); ++i) {
+    if (rng() % 16 != 0 || (valid[i] & 0xC0) != 0x80)
+      text += valid[i];
+  }
+  return text;
+}
+
+// Codepoint count the way callers walked strings before split()
+size_t decodeCount(std::string_view s) {
+  size_t count = 0;
+  for (size_t i = 0; i < s.size(); ++count) {
+    i += utf8::sequenceLength(s[i]);
+  }
+  return count;
+}
+
+template <typename F> double megabytesPerSecond(size_t bytes, F &&run) {
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < kRounds; ++r)
+    run();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return bytes * kRounds / elapsed.count() / (1 << 20);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::mt19937 rng(7);
+  std::vector<Input> inputs = {{"chinese", chineseText(rng)},
+                               {"ascii", asciiText(rng)},
+                               {"random bytes", randomBytes(rng)},
+                               {"truncated", truncatedText(rng)}};
+
+  Database db;
+  bool haveDb = argc >= 2 && db.init(argv[1]);
+  std::vector<utf8::Span> spans(kInputBytes);
+  std::string output;
+  output.reserve(kInputBytes * 2);
+
+  for (const Input &input : inputs) {
+    std::string_view s = input.text;
+    size_t count = utf8::split(s, spans.data(), spans.size());
+    // Same starts as the scalar rule, and the spans tile the input
+    size_t starts = s.empty() ? 0 : 1, covered = 0;
+    for (size_t i = 1; i < s.size(); ++i)
+      starts += (s[i] & 0xC0) != 0x80;
+    for (size_t i = 0; i < count; ++i) {
+      if (spans[i].offset != covered) {
+        std::cerr << "[tq9-bench-utf8] " << input.name
+                  << ": spans do not tile the input" << std::endl;
+        return 1;
+      }
+      covered += spans[i].length;
+    }
+    if (count != starts || covered != s.size()) {
+      std::cerr << "[tq9-bench-utf8] " << input.name << ": split found "
+                << count << " codepoints, expected " << starts << std::endl;
+      return 1;
+    }
+
+    size_t sink = 0;
+    double split = megabytesPerSecond(s.size(), [&] {
+      sink += utf8::split(s, spans.data(), spans.size());
+    });
+    double countOnly = megabytesPerSecond(
+        s.size(), [&] { sink += utf8::split(s, nullptr, 0); });
+    double decode =
+        megabytesPerSecond(s.size(), [&] { sink += decodeCount(s); });
+    std::cout << "[tq9-bench-utf8] " << input.name << " (" << count
+              << " codepoints): split " << (int)split << " MB/s, count "
+              << (int)countOnly << " MB/s, decode walk " << (int)decode
+              << " MB/s";
+    if (haveDb) {
+      double tcsc = megabytesPerSecond(s.size(), [&] {
+        output.clear();
+        db.tcsc(s, output);
+        sink += output.size();
+      });
+      std::cout << ", tcsc " << (int)tcsc << " MB/s";
+    }
+    std::cout << std::endl;
+    kept = sink;
+  }
+  return 0;
+}
@@ -0,0 +1,40 @@
+// tq9-lexicon: compile dataset.db into the memory-mapped lexicon read by
+// Database at runtime.
+//
+// Usage: tq9-lexicon <dataset.db> <dataset.lex>
+
+#include "Lexicon.h"
+#include <iostream>
+#include <sqlite3.h>
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <dataset.db> <dataset.lex>"
+              << std::endl;
+    return 2;
+  }
+
+  sqlite3 *db = nullptr;
+  if (sqlite3_open_v2(argv[1], &db, SQLITE_OPEN_READONLY, nullptr) !=
+      SQLITE_OK) {
+    std::cerr << "[tq9-lexicon] Can't open database: " << sqlite3_errmsg(db)
+              << std::endl;
+    sqlite3_close(db);
+    return 1;
+  }
+
+  bool ok = Lexicon::compile(db, argv[2]);
+  sqlite3_close(db);
+  if (!ok)
+    return 1;
+
+  Lexicon lexicon;
+  if (!lexicon.open(argv[2])) {
+    std::cerr << "[tq9-lexicon] Verification of " << argv[2] << " failed"
+              << std::endl;
+    return 1;
+  }
+  std::cerr << "[tq9-lexicon] Wrote " << argv[2] << " ("
+            << lexicon.symbolCount() << " symbols)" << std::endl;
+  return 0;
+}
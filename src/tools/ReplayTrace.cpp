@@ -0,0 +1,210 @@
+// tq9-replay: measure how often the next character is on the first page of
+// related words, by replaying typed text as a sequence of commits. Runs the
+// static related_candidates_table alone, then blended with a BigramModel
+// learning from the text as it goes. Then types the text through Q9Logic
+// under each auto-commit policy and reports the keystrokes per character.
+//
+// Usage: tq9-replay <dataset.db> <trace.txt>
+//
+// Every character of the trace is one commit. Whitespace is skipped (so a
+// usage journal replays as one stream); anything not in the database, such
+// as ASCII or punctuation, breaks the chain like a commit from elsewhere.
+
+#include "AutoCommit.h"
+#include "BigramModel.h"
+#include "Database.h"
+#include "Q9Logic.h"
+#include "UsageRanker.h"
+#include "Utf8.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static void replay(const Database &db, std::string_view text, bool learn) {
+  const SymbolTable &symbols = db.symbolTable();
+  BigramModel model;
+  std::vector<uint32_t> related;
+  size_t learned = 0;
+  uint32_t prev = SymbolTable::kNone;
+  std::string ch;
+  for (size_t i = 0; i < text.size();) {
+    char32_t cp = utf8::decode(text, i);
+    if (cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r')
+      continue;
+    ch.clear();
+    utf8::append(ch, cp);
+    uint32_t id = symbols.find(ch);
+    if (id == SymbolTable::kNone) {
+      prev = SymbolTable::kNone;
+      continue;
+    }
+    if (prev != SymbolTable::kNone) {
+      model.countRelate(related, learned, id);
+      if (learn) {
+        model.observe(prev, id);
+      }
+    }
+    prev = id;
+    learned = model.blend(id, db.getRelate(id), related);
+  }
+  std::cout << (learn ? "learned:" : "static:") << std::endl;
+  model.dumpStats(std::cout);
+}
+
+// Keys to choose target from candidates: key 0 pages, 1-9 choose
+static size_t chooseCost(std::span<const uint32_t> candidates,
+                         uint32_t target) {
+  auto it = std::find(candidates.begin(), candidates.end(), target);
+  if (it == candidates.end())
+    return SIZE_MAX;
+  size_t index = it - candidates.begin();
+  return index / 9 + 1;
+}
+
+static bool choose(Q9Logic &logic, uint32_t target) {
+  std::span<const uint32_t> candidates = logic.state().candidates;
+  auto it = std::find(candidates.begin(), candidates.end(), target);
+  if (it == candidates.end())
+    return false;
+  size_t index = it - candidates.begin();
+  for (size_t page = 0; page < index / 9; ++page) {
+    logic.processKey(0);
+  }
+  logic.processKey(index % 9 + 1);
+  return true;
+}
+
+// Types every character of the trace the cheapest way the screen offers:
+// from the chained related words, with the relate key, or by one of its
+// codes (paging to it unless the policy commits it). Usage ranking and
+// bigrams learn from the text as it goes, as they would for the user.
+static void typeTrace(const Database &db, std::string_view text,
+                      AutoCommit::Mode mode, bool chainRelate) {
+  const SymbolTable &symbols = db.symbolTable();
+  UsageRanker ranker;
+  ranker.attach(symbols, UsageRanker::Journal(), "/dev/null");
+  BigramModel bigrams;
+  AutoCommit policy;
+  policy.configure(mode, chainRelate);
+  Q9Logic logic(db, &ranker, &bigrams, &policy);
+  const Q9State &state = logic.state();
+
+  std::vector<uint32_t> scratch;
+  size_t unreachable = 0, reopened = 0, wrong = 0;
+  std::string ch;
+  for (size_t i = 0; i < text.size();) {
+    char32_t cp = utf8::decode(text, i);
+    if (cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r')
+      continue;
+    ch.clear();
+    utf8::append(ch, cp);
+    uint32_t target = symbols.find(ch);
+    if (target == SymbolTable::kNone) {
+      logic.reset();
+      continue;
+    }
+
+    // Cheapest code: its digits, then the keys to choose target, or none
+    // if the policy commits it; when it commits another candidate, PrevPage
+    // takes that back before choosing
+    int bestCode = -1;
+    size_t bestCost = SIZE_MAX;
+    for (uint16_t code : db.getCode(target)) {
+      if (!WildcardIndex::isTypable(code))
+        continue;
+      Lexicon::Words words = db.getWords(code);
+      scratch.assign(words.ids().begin(), words.ids().end());
+      ranker.rank(scratch);
+      size_t cost = code >= 100 ? 3 : 2;
+      bool committed = policy.shouldCommit(scratch, &ranker);
+      if (!committed || scratch[0] != target) {
+        size_t keys = chooseCost(scratch, target);
+        cost = keys == SIZE_MAX ? SIZE_MAX : cost + keys + committed;
+      }
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestCode = code;
+      }
+    }
+
+    bool selecting = state.mode == Q9Mode::Select;
+    size_t shown = selecting ? chooseCost(state.candidates, target) : SIZE_MAX;
+    scratch.assign(state.relatedWords.begin(), state.relatedWords.end());
+    ranker.rank(scratch);
+    size_t related = selecting ? SIZE_MAX : chooseCost(scratch, target);
+    if (related != SIZE_MAX) {
+      ++related; // The relate key
+    }
+
+    if (shown != SIZE_MAX && shown <= bestCost + 1) {
+      choose(logic, target);
+    } else if (related != SIZE_MAX && related <= bestCost) {
+      logic.processCommand(Q9Key::Relate);
+      choose(logic, target);
+    } else if (bestCode >= 0) {
+      if (selecting) {
+        logic.processCommand(Q9Key::Cancel);
+      }
+      std::string digits = std::to_string(bestCode);
+      for (char digit : digits) {
+        logic.processKey(digit - '0');
+      }
+      if (logic.hasCommitString() && logic.getCommitString() != ch) {
+        logic.clearCommitString();
+        logic.processCommand(Q9Key::PrevPage);
+        logic.clearRetractString();
+        ++reopened;
+      }
+      if (!logic.hasCommitString()) {
+        choose(logic, target);
+      }
+    } else {
+      ++unreachable;
+      logic.reset();
+      continue;
+    }
+    if (!logic.hasCommitString() || logic.getCommitString() != ch) {
+      ++wrong;
+      logic.reset();
+    }
+    logic.clearCommitString();
+  }
+  policy.dumpStats(std::cout);
+  std::cout << "[tq9-replay] skipped " << unreachable
+            << " characters without a typable code, " << reopened
+            << " typed by taking back an auto-commit; " << wrong
+            << " mistyped"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <dataset.db> <trace.txt>"
+              << std::endl;
+    return 2;
+  }
+
+  Database db;
+  if (!db.init(argv[1]))
+    return 1;
+  std::ifstream in(argv[2], std::ios::binary);
+  if (!in) {
+    std::cerr << "[tq9-replay] Can't read " << argv[2] << std::endl;
+    return 1;
+  }
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  std::string text = buffer.str();
+
+  replay(db, text, false);
+  replay(db, text, true);
+  for (AutoCommit::Mode mode : {AutoCommit::Mode::Off, AutoCommit::Mode::Unique,
+                                AutoCommit::Mode::Dominant}) {
+    typeTrace(db, text, mode, false);
+    typeTrace(db, text, mode, true);
+  }
+  return 0;
+}
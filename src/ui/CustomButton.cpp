@@ -99,13 +99,16 @@ void CustomButton::paintEvent(QPaintEvent *event) {
     }
 
     if (hasImage) {
-      // Both: Text on bottom right
+      // Both: Text on bottom right, fully opaque even over a faded image
+      painter.save();
+      painter.setOpacity(m_disabled ? 0.5 : 1.0);
       // Use a smaller font for corner label (approx 40% of height)
       int cornerFontSize = height() * 0.4;
       font.setPixelSize(qMax(8, cornerFontSize));
       painter.setFont(font);
       painter.drawText(rect().adjusted(2, 2, -4, -4),
                        Qt::AlignBottom | Qt::AlignRight, m_text);
+      painter.restore();
     } else {
       // Only text: Center
       font.setPixelSize(qMax(8, fontSize));
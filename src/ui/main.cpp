@@ -101,6 +101,26 @@ static void initializeButtons(FloatingWindow &window, const QString &basePath) {
             << std::endl;
 }
 
+// Hand each "id:text" item of an "id:text|id:text..." argument to apply,
+// with the button it names; items without a numeric id or an existing
+// button are skipped
+template <typename Apply>
+static void forEachButtonItem(FloatingWindow &window, const QString &content,
+                              Apply apply) {
+  for (const QString &item : content.split('|')) {
+    int colIdx = item.indexOf(':');
+    if (colIdx == -1)
+      continue;
+    bool ok;
+    int id = item.left(colIdx).trimmed().toInt(&ok);
+    if (!ok)
+      continue;
+    if (CustomButton *btn = window.getButton(id)) {
+      apply(id, btn, item.mid(colIdx + 1));
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
   // Initialize LayerShellQt before QApplication
   // This sets the environment for Wayland layer-shell integration
@@ -174,34 +194,19 @@ int main(int argc, char *argv[]) {
           std::cout << (active ? "FOCUS_TRUE" : "FOCUS_FALSE") << std::endl;
         } else if (line.startsWith("UPDATE_BUTTONS")) {
           QString content = line.mid(14).trimmed(); // UPDATE_BUTTONS (len 14)
-          if (!content.isEmpty()) {
-            QStringList items = content.split('|');
-            for (const QString &item : items) {
-              if (item.isEmpty())
-                continue;
-              int colIdx = item.indexOf(':');
-              if (colIdx != -1) {
-                bool ok;
-                int id = item.left(colIdx).trimmed().toInt(&ok);
-                if (ok) {
-                  QString text = item.mid(colIdx + 1);
-                  CustomButton *btn = window.getButton(id);
-                  if (btn) {
-                    btn->setText(text);
-                    btn->setImage(""); // Clear image for text display
-                    btn->setOpacity(1);
-                    if (text.isEmpty()) {
-                      btn->setBackgroundColor(Qt::gray);
-                      btn->setDisabledState(true);
-                    } else {
-                      btn->setBackgroundColor(Qt::white);
-                      btn->setDisabledState(false);
-                    }
-                  }
-                }
-              }
-            }
-          }
+          forEachButtonItem(window, content,
+                            [](int, CustomButton *btn, const QString &text) {
+                              btn->setText(text);
+                              btn->setImage(""); // Clear image for text
+                              btn->setOpacity(1);
+                              if (text.isEmpty()) {
+                                btn->setBackgroundColor(Qt::gray);
+                                btn->setDisabledState(true);
+                              } else {
+                                btn->setBackgroundColor(Qt::white);
+                                btn->setDisabledState(false);
+                              }
+                            });
         } else if (line.startsWith("SET_IMAGES ")) {
           // SET_IMAGES <type> - set button 1-9 images to type_1.png through
           // type_9.png
@@ -252,48 +257,27 @@ int main(int argc, char *argv[]) {
             }
           }
 
-          // Then overlay with related text
-          if (!content.isEmpty()) {
-            QStringList items = content.split('|');
-            for (const QString &item : items) {
-              if (item.isEmpty())
-                continue;
-              int colIdx = item.indexOf(':');
-              if (colIdx != -1) {
-                bool ok;
-                int id = item.left(colIdx).trimmed().toInt(&ok);
-                if (ok && id >= 1 && id <= 9) {
-                  QString text = item.mid(colIdx + 1);
-                  CustomButton *btn = window.getButton(id);
-                  if (btn) {
-                    // Show text over image - using small top-left alignment
-                    btn->setText(text);
-                  }
-                }
-              }
-            }
-          }
-
-          // Handle button 0 and 10 text
-          QStringList items = content.split('|');
-          for (const QString &item : items) {
-            if (item.isEmpty())
-              continue;
-            int colIdx = item.indexOf(':');
-            if (colIdx != -1) {
-              bool ok;
-              int id = item.left(colIdx).trimmed().toInt(&ok);
-              if (ok && (id == 0 || id == 10)) {
-                QString text = item.mid(colIdx + 1);
-                CustomButton *btn = window.getButton(id);
-                if (btn) {
+          // Then overlay with related text, and label buttons 0 and 10
+          forEachButtonItem(
+              window, content,
+              [](int id, CustomButton *btn, const QString &text) {
+                if (id >= 1 && id <= 9) {
+                  btn->setText(text);
+                } else if (id == 0 || id == 10) {
                   btn->setText(text);
                   btn->setImage("");
                   btn->setBackgroundColor(Qt::white);
                 }
-              }
-            }
-          }
+              });
+        } else if (line.startsWith("SET_PREVIEW")) {
+          // SET_PREVIEW id:text|id:text... - label buttons 1-9 with what the
+          // third digit would give, keeping the semi-transparent images
+          forEachButtonItem(window, line.mid(11).trimmed(),
+                            [](int id, CustomButton *btn, const QString &text) {
+                              if (id >= 1 && id <= 9) {
+                                btn->setText(text);
+                              }
+                            });
         } else if (line.startsWith("SET_STATUS ")) {
           // SET_STATUS <text> - set window title and status label
           QString statusText = line.mid(11).trimmed();
@@ -0,0 +1,81 @@
+// Typing must not touch the heap once Q9Logic is warm: every code is typed,
+// paged through and chosen from once, then again while global operator new
+// counts. Any allocation in the second pass fails the test.
+//
+// Usage: tq9-test-alloc <dataset.db | fixture.sql>
+
+#include "Database.h"
+#include "Fixture.h"
+#include "Q9Logic.h"
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace {
+size_t allocations = 0;
+bool counting = false;
+} // namespace
+
+void *operator new(std::size_t size) {
+  if (counting) {
+    ++allocations;
+  }
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Every three-digit code: type it, page forward and back, choose, show the
+// related words, then end a one-digit code early with 0
+void typeEveryCode(Q9Logic &logic) {
+  for (int a = 1; a <= 9; ++a) {
+    for (int b = 1; b <= 9; ++b) {
+      for (int c = 1; c <= 9; ++c) {
+        logic.processKey(a);
+        logic.processKey(b);
+        logic.processKey(c);
+        for (int i = 0; i < 5; ++i) {
+          logic.processCommand(Q9Key::NextPage);
+          logic.processCommand(Q9Key::PrevPage);
+          logic.processKey(0);
+        }
+        logic.processKey(1);
+        logic.clearCommitString();
+        logic.processCommand(Q9Key::Relate);
+        logic.processKey(0);
+        logic.processCommand(Q9Key::Cancel);
+        logic.processKey(a);
+        logic.processKey(0);
+        logic.processCommand(Q9Key::Cancel);
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <dataset.db | fixture.sql>"
+              << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+  Q9Logic logic(db);
+
+  typeEveryCode(logic);
+  counting = true;
+  typeEveryCode(logic);
+  counting = false;
+
+  std::cout << "[tq9-test-alloc] " << allocations
+            << " allocations in steady state" << std::endl;
+  return allocations == 0 ? 0 : 1;
+}
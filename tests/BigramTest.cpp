@@ -0,0 +1,128 @@
+// BigramModel bookkeeping: a follower counts from its second commit, a
+// newcomer to a full row takes over the least frequent slot and its count
+// (Space-Saving), a full table halves every count and drops the rows left
+// empty, and learned followers lead the related list without repeating it.
+//
+// Usage: tq9-test-bigram <fixture.sql>
+
+#include "BigramModel.h"
+#include "Database.h"
+#include "Fixture.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+    ++failures;
+  }
+}
+
+std::vector<uint32_t> learned(const BigramModel &model, uint32_t prev) {
+  std::vector<uint32_t> out;
+  out.resize(model.blend(prev, RelateIndex::List(), out));
+  return out;
+}
+
+void testMinCount() {
+  BigramModel model(16);
+  model.observe(1, 2);
+  check(learned(model, 1).empty(), "min count: one commit is not enough");
+  model.observe(1, 2);
+  check(learned(model, 1) == std::vector<uint32_t>{2},
+        "min count: learned from the second commit");
+  model.observe(SymbolTable::kNone, 2);
+  check(learned(model, SymbolTable::kNone).empty(),
+        "min count: nothing learned without a previous character");
+}
+
+void testSpaceSaving() {
+  BigramModel model(16);
+  // Followers 10..17 twice each fill the row, in that order
+  for (uint32_t next = 10; next < 10 + BigramModel::kFollowers; ++next) {
+    model.observe(1, next);
+    model.observe(1, next);
+  }
+  model.observe(1, 99);
+  std::vector<uint32_t> expected{99, 10, 11, 12, 13, 14, 15, 16};
+  check(learned(model, 1) == expected,
+        "space-saving: newcomer replaces the last follower, one above it");
+
+  // The evicted follower comes back like any newcomer, over 16
+  model.observe(1, 17);
+  expected = {99, 17, 10, 11, 12, 13, 14, 15};
+  check(learned(model, 1) == expected,
+        "space-saving: evicted follower takes over the last slot");
+}
+
+void testPrune() {
+  // Eight rows hold at most six previous characters
+  BigramModel model(8);
+  size_t memory = model.memoryUsage();
+  for (int i = 0; i < 4; ++i)
+    model.observe(1, 10);
+  for (uint32_t prev = 2; prev <= 6; ++prev)
+    model.observe(prev, 10);
+  model.observe(7, 10);
+  model.observe(7, 10);
+
+  check(learned(model, 1) == std::vector<uint32_t>{10},
+        "prune: frequent follower kept at half its count");
+  model.observe(2, 10);
+  check(learned(model, 2).empty(), "prune: rows seen once dropped");
+  check(learned(model, 7) == std::vector<uint32_t>{10},
+        "prune: the new row inserted after pruning");
+  check(model.memoryUsage() == memory, "prune: table does not grow");
+  std::ostringstream stats;
+  model.dumpStats(stats);
+  check(stats.str().find(" 1 prunes") != std::string::npos,
+        "prune: pruned once");
+}
+
+void testBlend(const Database &db) {
+  const SymbolTable &symbols = db.symbolTable();
+  uint32_t wo = symbols.find("我"), women = symbols.find("我们"),
+           wode = symbols.find("我的"), ni = symbols.find("你");
+  BigramModel model(16);
+  model.observe(wo, wode);
+  model.observe(wo, wode);
+  model.observe(wo, ni);
+  model.observe(wo, ni);
+  model.observe(wo, ni);
+
+  std::vector<uint32_t> out;
+  size_t count = model.blend(wo, db.getRelate(wo), out);
+  std::vector<uint32_t> expected{ni, wode, women};
+  check(count == 2 && out == expected,
+        "blend: learned first, related after without repeats");
+  model.countRelate(out, count, wode);
+  std::ostringstream stats;
+  model.dumpStats(stats);
+  check(stats.str().find("1 on learned entries") != std::string::npos,
+        "blend: hit on a learned entry counted");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <fixture.sql>" << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+
+  testMinCount();
+  testSpaceSaving();
+  testPrune();
+  testBlend(db);
+
+  std::cout << "[tq9-test-bigram] " << failures << " failures" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// The database a test is given: data/dataset.db as is, or an SQL script
+// such as tests/fixture.sql, run into a scratch database first. The data
+// set is not shipped, so a missing file skips the test instead of failing.
+
+#include "Database.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sqlite3.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace fixture {
+
+// Exit status ctest counts as skipped (SKIP_RETURN_CODE in CMakeLists.txt)
+constexpr int kSkipped = 77;
+
+// Runs the script into a new database at dbPath
+inline bool build(const std::string &script, const std::string &dbPath) {
+  std::ifstream in(script);
+  std::ostringstream sql;
+  sql << in.rdbuf();
+  sqlite3 *db = nullptr;
+  bool ok = in && sqlite3_open(dbPath.c_str(), &db) == SQLITE_OK &&
+            sqlite3_exec(db, sql.str().c_str(), nullptr, nullptr, nullptr) ==
+                SQLITE_OK;
+  if (!ok) {
+    std::cerr << "[fixture] " << script << ": "
+              << (db ? sqlite3_errmsg(db) : "cannot read") << std::endl;
+  }
+  sqlite3_close(db);
+  return ok;
+}
+
+// Returns the test's exit status so far: 0 once db is ready, kSkipped if
+// path does not exist, 1 if it cannot be loaded
+inline int open(Database &db, const std::string &path) {
+  if (access(path.c_str(), R_OK) != 0) {
+    std::cerr << "[fixture] " << path << " does not exist, skipping"
+              << std::endl;
+    return kSkipped;
+  }
+  if (!path.ends_with(".sql"))
+    return db.init(path) ? 0 : 1;
+
+  const char *tmp = std::getenv("TMPDIR");
+  std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/tq9-XXXXXX";
+  if (!mkdtemp(dir.data())) {
+    std::cerr << "[fixture] cannot create " << dir << std::endl;
+    return 1;
+  }
+  std::string dbPath = dir + "/fixture.db";
+  bool ok = build(path, dbPath) && db.init(dbPath);
+  // Database answers everything from memory once init returns
+  unlink(dbPath.c_str());
+  rmdir(dir.c_str());
+  return ok ? 0 : 1;
+}
+
+} // namespace fixture
@@ -0,0 +1,126 @@
+// PhraseTrie lookups: every sequence leads to the phrases added under it
+// and to no others, prefixes are nodes of their own, and codes that were
+// never added (or cannot be typed) lead nowhere. Then the trie Database
+// builds from the fixture: a phrase is reachable under every combination
+// of its characters' codes.
+//
+// Usage: tq9-test-phrases <fixture.sql>
+
+#include "Database.h"
+#include "Fixture.h"
+#include "PhraseTrie.h"
+#include <algorithm>
+#include <initializer_list>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+    ++failures;
+  }
+}
+
+PhraseTrie::Entry entry(std::initializer_list<uint16_t> codes,
+                        uint32_t phrase) {
+  PhraseTrie::Entry e;
+  for (uint16_t code : codes)
+    e.codes[e.length++] = code;
+  e.phrase = phrase;
+  return e;
+}
+
+PhraseTrie::Node walk(const PhraseTrie &trie,
+                      std::initializer_list<int> codes) {
+  PhraseTrie::Node node = PhraseTrie::kRoot;
+  for (int code : codes)
+    node = trie.next(node, code);
+  return node;
+}
+
+std::vector<uint32_t> phrasesAt(const PhraseTrie &trie,
+                                std::initializer_list<int> codes) {
+  std::span<const uint32_t> ids = trie.phrases(walk(trie, codes));
+  return std::vector<uint32_t>(ids.begin(), ids.end());
+}
+
+void testLookup() {
+  PhraseTrie trie;
+  // Unsorted, with a repeat, a prefix of another and a shared node
+  trie.build({entry({12, 345}, 7), entry({12, 345, 6}, 8),
+              entry({12, 345}, 3), entry({12, 345}, 7),
+              entry({999, 1}, 9)});
+
+  check(trie.phraseCount() == 4, "lookup: repeats dropped");
+  check(phrasesAt(trie, {12, 345}) == std::vector<uint32_t>{3, 7},
+        "lookup: phrases of a node sorted by id");
+  check(phrasesAt(trie, {12, 345, 6}) == std::vector<uint32_t>{8},
+        "lookup: longer sequence past a shorter one");
+  check(phrasesAt(trie, {999, 1}) == std::vector<uint32_t>{9},
+        "lookup: highest code");
+  check(walk(trie, {12}) != PhraseTrie::kNoNode &&
+            phrasesAt(trie, {12}).empty(),
+        "lookup: a prefix is a node without phrases");
+  check(walk(trie, {345}) == PhraseTrie::kNoNode,
+        "lookup: sequences start at the root");
+  check(walk(trie, {12, 345, 7}) == PhraseTrie::kNoNode &&
+            walk(trie, {12, 345, 6, 1}) == PhraseTrie::kNoNode,
+        "lookup: no node past the added sequences");
+  check(trie.next(PhraseTrie::kRoot, 0) == PhraseTrie::kNoNode &&
+            trie.next(PhraseTrie::kRoot, 1000) == PhraseTrie::kNoNode &&
+            trie.next(PhraseTrie::kNoNode, 12) == PhraseTrie::kNoNode,
+        "lookup: out of range codes and nodes");
+  check(trie.phrases(PhraseTrie::kNoNode).empty(),
+        "lookup: no phrases past the end");
+
+  PhraseTrie empty;
+  check(empty.next(PhraseTrie::kRoot, 12) == PhraseTrie::kNoNode,
+        "lookup: empty trie");
+  empty.build({});
+  check(empty.next(PhraseTrie::kRoot, 12) == PhraseTrie::kNoNode &&
+            empty.phrases(PhraseTrie::kRoot).empty(),
+        "lookup: trie built from nothing");
+}
+
+bool contains(const std::vector<uint32_t> &ids, uint32_t id) {
+  return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+// In the fixture, 你 is under 456 and 好 under 70 and 456; 我, 们 and 的
+// are all under 111
+void testDatabase(const Database &db) {
+  const PhraseTrie &trie = db.phraseTrie();
+  const SymbolTable &symbols = db.symbolTable();
+  uint32_t nihao = symbols.find("你好");
+  check(contains(phrasesAt(trie, {456, 70}), nihao) &&
+            contains(phrasesAt(trie, {456, 456}), nihao),
+        "database: phrase under each code of its characters");
+  std::vector<uint32_t> wo = phrasesAt(trie, {111, 111});
+  check(contains(wo, symbols.find("我们")) &&
+            contains(wo, symbols.find("我的")),
+        "database: phrases sharing a sequence");
+  check(!contains(phrasesAt(trie, {456}), nihao),
+        "database: no phrase under a single character");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <fixture.sql>" << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+
+  testLookup();
+  testDatabase(db);
+
+  std::cout << "[tq9-test-phrases] " << failures << " failures" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// Walks every state Q9Logic can reach from a fresh context, breadth first
+// over all keys, and checks each against the invariants the old boolean
+// flags could break: candidates only while choosing, a code only while
+// typing, bracket pairs only in OpenClose. States that look the same
+// (mode, code, list, page, relate) are explored once; the walk stops at
+// kMaxDepth keys, enough to reach every mode.
+//
+// Usage: tq9-test-transitions <dataset.db | fixture.sql>
+
+#include "Database.h"
+#include "Fixture.h"
+#include "Q9Logic.h"
+#include "Q9Transitions.h"
+#include <algorithm>
+#include <bitset>
+#include <deque>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace q9;
+
+namespace {
+
+constexpr size_t kMaxDepth = 7;
+
+const char *modeName(Q9Mode mode) {
+  static const char *const names[] = {
+      "Idle",      "Input",    "Select",    "Homophone", "OpenClose",
+      "HomoIdle",  "HomoInput", "HomoSelect", "Phrase"};
+  static_assert(std::size(names) == kModeCount);
+  return names[(size_t)mode];
+}
+
+bool isBracketList(const Database &db, const Q9State &state) {
+  std::span<const uint32_t> pairs = db.getBracketPairs();
+  return std::equal(state.candidates.begin(), state.candidates.end(),
+                    pairs.begin(), pairs.end());
+}
+
+// Empty if state is valid, else what is wrong with it
+std::string checkState(const Database &db, const Q9State &state) {
+  Q9Mode mode = state.mode;
+  if (isSelectMode(mode)) {
+    if (state.candidates.empty())
+      return "choosing from no candidates";
+    if (state.totalPages != (int)(state.candidates.size() + 8) / 9)
+      return "page count does not match the candidates";
+    if (state.page < 0 || state.page >= state.totalPages)
+      return "page out of range";
+    if (state.imageType != -1)
+      return "images shown while choosing";
+    if (!state.inputCode.empty())
+      return "code left over while choosing";
+    if (state.hasCandidates != !state.pageCandidates().empty())
+      return "hasCandidates out of date";
+    if ((mode == Q9Mode::OpenClose) != isBracketList(db, state))
+      return "bracket pairs outside OpenClose, or words inside it";
+  } else if (!state.candidates.empty()) {
+    return "candidates left over outside selection";
+  }
+  bool typing = mode == Q9Mode::Input || mode == Q9Mode::HomoInput;
+  if (typing && state.inputCode.empty())
+    return "typing mode without a code";
+  if (!typing && mode != Q9Mode::Phrase && !state.inputCode.empty())
+    return "code left over outside typing";
+  return {};
+}
+
+std::string signature(const Q9State &state) {
+  std::ostringstream out;
+  out << (int)state.mode << '|' << state.inputCode.view() << '|'
+      << state.candidates.size() << '|'
+      << (state.candidates.empty() ? 0 : state.candidates[0]) << '|'
+      << state.page << '|' << (state.lastWord != SymbolTable::kNone) << '|'
+      << state.relatedWords.empty();
+  return out.str();
+}
+
+void replay(Q9Logic &logic, const std::vector<Q9Key> &keys) {
+  logic.reset();
+  for (Q9Key key : keys) {
+    logic.processCommand(key);
+    logic.clearCommitString();
+  }
+}
+
+std::string describe(const std::vector<Q9Key> &keys) {
+  std::string out;
+  for (Q9Key key : keys) {
+    out += std::to_string((int)key);
+    out += ' ';
+  }
+  return out;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <dataset.db | fixture.sql>"
+              << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+  Q9Logic logic(db);
+
+  std::set<std::string> seen{signature(logic.state())};
+  std::deque<std::vector<Q9Key>> queue{{}};
+  std::bitset<kModeCount * kInputCount> cells;
+  std::bitset<kModeCount> modes;
+  size_t states = 0, failures = 0;
+
+  while (!queue.empty()) {
+    std::vector<Q9Key> keys = std::move(queue.front());
+    queue.pop_front();
+    ++states;
+    for (size_t input = 0; input < kInputCount; ++input) {
+      replay(logic, keys);
+      const Q9State &state = logic.state();
+      Q9Mode before = state.mode;
+      uint32_t lastWord = state.lastWord;
+      bool wildcard = state.inputCode.hasWildcard();
+      std::string unchanged = signature(state) + state.statusPrefix;
+      cells.set((size_t)before * kInputCount + input);
+      modes.set((size_t)before);
+
+      logic.processCommand((Q9Key)input);
+      keys.push_back((Q9Key)input);
+      std::string problem = checkState(db, state);
+      // A bracket pair is never taken for the last word
+      if (problem.empty() && logic.hasCommitString() &&
+          kTransitions[(size_t)before][input] == Q9Action::CommitBracket &&
+          state.lastWord != lastWord)
+        problem = "bracket pair committed as a word";
+      // Shortcut categories are digits; a wildcard has none
+      if (problem.empty() && wildcard && input == (size_t)Q9Key::Shortcut &&
+          signature(state) + state.statusPrefix != unchanged)
+        problem = "shortcut taken for a wildcard";
+      if (!problem.empty()) {
+        if (++failures <= 20) {
+          std::cerr << "FAIL after keys [" << describe(keys)
+                    << "] in " << modeName(state.mode) << ": " << problem
+                    << std::endl;
+        }
+      } else if (keys.size() < kMaxDepth &&
+                 seen.insert(signature(state)).second) {
+        queue.push_back(keys);
+      }
+      keys.pop_back();
+    }
+  }
+
+  size_t live = 0;
+  for (size_t cell = 0; cell < cells.size(); ++cell) {
+    live += cells[cell] &&
+            kTransitions[cell / kInputCount][cell % kInputCount] !=
+                Q9Action::None;
+  }
+  std::cout << "[tq9-test-transitions] " << states << " states, "
+            << cells.count() << "/" << cells.size() << " mode x key cells ("
+            << live << " with an action), " << failures << " failures"
+            << std::endl;
+  for (size_t m = 0; m < kModeCount; ++m) {
+    if (!modes[m]) {
+      std::cerr << "FAIL: mode " << modeName((Q9Mode)m) << " never reached"
+                << std::endl;
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
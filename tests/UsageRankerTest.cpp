@@ -0,0 +1,170 @@
+// The usage journal round trip: loading ignores a torn last line and
+// replays snapshot lines before appended ones, a compaction keeps the
+// selections made while its snapshot was written, and an append that does
+// not reach the file gives its lines back to the buffer.
+//
+// Usage: tq9-test-usage <fixture.sql>
+
+#include "Database.h"
+#include "Fixture.h"
+#include "UsageRanker.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+    ++failures;
+  }
+}
+
+void writeFile(const std::string &path, const std::string &data) {
+  FILE *f = fopen(path.c_str(), "wb");
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+}
+
+std::string readFile(const std::string &path) {
+  std::string data;
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.append(buf, n);
+  fclose(f);
+  return data;
+}
+
+float scoreOf(const UsageRanker::Journal &journal, const std::string &word) {
+  for (const auto &[w, score] : journal.scores) {
+    if (w == word)
+      return score;
+  }
+  return 0;
+}
+
+void testTornLine(const std::string &path) {
+  writeFile(path, "我\n你\n我\n好");
+  UsageRanker::Journal journal = UsageRanker::load(path);
+  check(journal.lines == 3, "torn line: three whole lines");
+  check(scoreOf(journal, "我") > scoreOf(journal, "你") &&
+            scoreOf(journal, "你") > 0,
+        "torn line: whole lines replayed");
+  check(scoreOf(journal, "好") == 0, "torn line: last line ignored");
+}
+
+// Snapshot scores are in units of the selection after them; the appended
+// lines then count one each, growing
+void testSnapshotThenAppended(const Database &db, const std::string &path) {
+  writeFile(path, "我\t3\n你\t1\n你\n你\n你\n");
+  UsageRanker::Journal journal = UsageRanker::load(path);
+  check(journal.lines == 5, "snapshot: five lines");
+  check(scoreOf(journal, "你") > scoreOf(journal, "我"),
+        "snapshot: appended lines add to the snapshot score");
+  check(scoreOf(journal, "我") > 2.9f && scoreOf(journal, "我") < 3,
+        "snapshot: older score decays by the appended selections");
+
+  UsageRanker ranker;
+  ranker.attach(db.symbolTable(), journal, path);
+  std::vector<uint32_t> ids{db.symbolTable().find("的"),
+                            db.symbolTable().find("我"),
+                            db.symbolTable().find("你")};
+  std::vector<uint32_t> expected{ids[2], ids[1], ids[0]};
+  ranker.rank(ids);
+  check(ids == expected, "snapshot: ranked by the replayed scores");
+}
+
+void testCompaction(const Database &db, const std::string &path) {
+  unlink(path.c_str());
+  const SymbolTable &symbols = db.symbolTable();
+  uint32_t wo = symbols.find("我"), ni = symbols.find("你");
+  UsageRanker ranker;
+  ranker.attach(symbols, UsageRanker::load(path), path);
+  for (int i = 0; i < 3; ++i)
+    ranker.record(wo);
+
+  std::string snapshot = ranker.snapshot();
+  // Chosen while the snapshot is written: kept for the next append
+  ranker.record(ni);
+  check(!ranker.appendDue(), "compaction: no append while compacting");
+  check(UsageRanker::writeSnapshot(path, snapshot),
+        "compaction: snapshot written");
+  check(ranker.finishCompaction(true), "compaction: renamed into place");
+  check(ranker.appendDue(), "compaction: selections made meanwhile due");
+  std::string pending = ranker.takeJournal();
+  check(pending == "你\n", "compaction: only the later selection buffered");
+  check(ranker.finishAppend(UsageRanker::appendJournal(path, pending)),
+        "compaction: appended");
+
+  check(readFile(path) == snapshot + pending,
+        "compaction: snapshot, then the appended line");
+  UsageRanker::Journal journal = UsageRanker::load(path);
+  check(journal.lines == 2, "compaction: one snapshot line, one appended");
+  check(scoreOf(journal, "我") > 2.9f && scoreOf(journal, "你") > 0.9f,
+        "compaction: both selections survive");
+}
+
+void testFailedAppend(const Database &db, const std::string &dir) {
+  const SymbolTable &symbols = db.symbolTable();
+  // A journal in a directory that does not exist cannot be opened
+  std::string path = dir + "/missing/usage.journal";
+  UsageRanker ranker;
+  ranker.attach(symbols, UsageRanker::load(path), path);
+  ranker.record(symbols.find("我"));
+  ranker.record(symbols.find("你"));
+
+  UsageRanker::Batch batch =
+      UsageRanker::appendJournal(path, ranker.takeJournal());
+  check(batch.written == 0, "failed append: nothing written");
+  check(!ranker.finishAppend(std::move(batch)),
+        "failed append: reported as failed");
+  ranker.record(symbols.find("好"));
+  check(ranker.takeJournal() == "我\n你\n好\n",
+        "failed append: lines back in front of the buffer");
+
+  // Half a line reached the file: the next batch starts with the rest
+  ranker.finishAppend({"你\n好\n", 2});
+  check(ranker.takeJournal() == "\xa0\n好\n",
+        "short append: unwritten tail kept");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <fixture.sql>" << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+
+  const char *tmp = std::getenv("TMPDIR");
+  std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/tq9-XXXXXX";
+  if (!mkdtemp(dir.data())) {
+    std::cerr << "cannot create " << dir << std::endl;
+    return 1;
+  }
+  std::string path = dir + "/usage.journal";
+
+  testTornLine(path);
+  testSnapshotThenAppended(db, path);
+  testCompaction(db, path);
+  testFailedAppend(db, dir);
+
+  unlink(path.c_str());
+  unlink((path + ".tmp").c_str());
+  rmdir(dir.c_str());
+  std::cout << "[tq9-test-usage] " << failures << " failures" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// The user overlay from file to candidates: overlay.txt parsing, the merge
+// of front and hidden words over a code's system candidates, rebuilding
+// only the codes whose edits changed, wildcard search following codes the
+// overlay empties or fills, and dropping an edit bringing the system list
+// back.
+//
+// Usage: tq9-test-overlay <fixture.sql>
+
+#include "Database.h"
+#include "Fixture.h"
+#include "UserLexicon.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+    ++failures;
+  }
+}
+
+std::vector<std::string> words(const Database &db, int code) {
+  std::vector<std::string> out;
+  for (uint32_t id : db.getWords(code).ids())
+    out.emplace_back(db.symbolTable().str(id));
+  return out;
+}
+
+bool wildcardHas(const Database &db, std::string_view pattern, int code) {
+  bool found = false;
+  db.wildcardIndex().forEachMatch(pattern,
+                                  [&](int match) { found |= match == code; });
+  return found;
+}
+
+void testLoad(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "wb");
+  fputs("# comment\n"
+        "123 事 新 -去\r\n"
+        "\n"
+        "abc 好\n"
+        "0 好\n"
+        "1010 好\n"
+        "123 -\t久\n",
+        f);
+  fclose(f);
+  UserLexicon::Edits edits = UserLexicon::load(path);
+  UserLexicon::Edit expected{{"事", "新", "久"}, {"去"}};
+  check(edits.size() == 1 && edits[123] == expected,
+        "load: lines of one code add up, bad codes and lone '-' skipped");
+  check(UserLexicon::load(path + ".missing").empty(),
+        "load: a missing file is an empty overlay");
+}
+
+void testMerge(Database &db) {
+  uint64_t generation = db.overlayGeneration();
+  UserLexicon::Edits edits;
+  // Front words first, in order and once; hidden words nowhere, even when
+  // also put in front; the rest of the system list after
+  edits[123] = {{"事", "新", "事", "子"}, {"去", "子", "没有"}};
+  check(db.applyOverlay(edits) == 1, "merge: one code rebuilt");
+  check(words(db, 123) == std::vector<std::string>{"事", "新", "起"},
+        "merge: front, then system candidates not hidden");
+  check(db.overlayGeneration() != generation, "merge: generation bumped");
+  check(words(db, 111).size() == 12, "merge: other codes untouched");
+
+  generation = db.overlayGeneration();
+  check(db.applyOverlay(edits) == 0 && db.overlayGeneration() == generation,
+        "merge: same edits rebuild nothing");
+
+  // Emptying a code takes it out of wildcard search, filling one adds it
+  edits[50] = {{}, {"山", "出"}};
+  edits[222] = {{"久"}, {}};
+  check(db.applyOverlay(edits) == 2, "merge: only the new codes rebuilt");
+  check(db.getWords(50).empty() && !wildcardHas(db, "?0", 50),
+        "merge: emptied code leaves wildcard search");
+  check(words(db, 222) == std::vector<std::string>{"久"} &&
+            wildcardHas(db, "2?2", 222),
+        "merge: filled code joins wildcard search");
+}
+
+void testUnedit(Database &db) {
+  UserLexicon::Edits edits;
+  edits[222] = {{"久"}, {}};
+  check(db.applyOverlay(edits) == 2, "unedit: dropped codes rebuilt");
+  check(words(db, 123) == std::vector<std::string>{"起", "去", "子", "事"},
+        "unedit: system list back");
+  check(words(db, 50).size() == 2 && wildcardHas(db, "?0", 50),
+        "unedit: emptied code back in wildcard search");
+
+  check(db.applyOverlay({}) == 1, "unedit: last code rebuilt");
+  check(db.getWords(222).empty() && !wildcardHas(db, "2?2", 222),
+        "unedit: no overlay left");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <fixture.sql>" << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+
+  const char *tmp = std::getenv("TMPDIR");
+  std::string dir = std::string(tmp && *tmp ? tmp : "/tmp") + "/tq9-XXXXXX";
+  if (!mkdtemp(dir.data())) {
+    std::cerr << "cannot create " << dir << std::endl;
+    return 1;
+  }
+  std::string path = dir + "/overlay.txt";
+
+  testLoad(path);
+  testMerge(db);
+  testUnedit(db);
+
+  unlink(path.c_str());
+  rmdir(dir.c_str());
+  std::cout << "[tq9-test-overlay] " << failures << " failures" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
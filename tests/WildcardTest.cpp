@@ -0,0 +1,121 @@
+// WildcardIndex matching against a scan of the codes: every pattern of two
+// or three digits and wildcards, over a random half of the typable codes,
+// finds exactly the codes that read like it, in ascending order. set() is
+// idempotent and ignores codes that cannot be typed, and the index built
+// from the fixture holds the codes that have candidates.
+//
+// Usage: tq9-test-wildcard <fixture.sql>
+
+#include "Database.h"
+#include "Fixture.h"
+#include "WildcardIndex.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+void check(bool ok, const std::string &what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+    ++failures;
+  }
+}
+
+std::vector<int> matches(const WildcardIndex &index, std::string_view pattern) {
+  std::vector<int> codes;
+  index.forEachMatch(pattern, [&](int code) { codes.push_back(code); });
+  return codes;
+}
+
+std::vector<int> scan(const std::vector<bool> &present,
+                      std::string_view pattern) {
+  std::vector<int> codes;
+  for (int code = 0; code < (int)present.size(); ++code) {
+    std::string digits = std::to_string(code);
+    if (!present[code] || digits.size() != pattern.size())
+      continue;
+    bool match = true;
+    for (size_t i = 0; i < digits.size(); ++i) {
+      match = match && (pattern[i] == WildcardIndex::kAny ||
+                        pattern[i] == digits[i]);
+    }
+    if (match)
+      codes.push_back(code);
+  }
+  return codes;
+}
+
+void testAgainstScan() {
+  std::mt19937 rng(5);
+  WildcardIndex index;
+  std::vector<bool> present(1000, false);
+  size_t count = 0;
+  for (int code = 0; code < 1000; ++code) {
+    if (WildcardIndex::isTypable(code) && rng() % 2) {
+      index.set(code, true);
+      present[code] = true;
+      ++count;
+    }
+  }
+  // Setting again, or codes that cannot be typed, changes nothing
+  index.set(111, present[111]);
+  index.set(105, true);
+  index.set(5, true);
+  index.set(1000, true);
+  check(index.codeCount() == count, "scan: code count");
+
+  const char symbols[] = "0123456789?";
+  std::string pattern;
+  for (size_t length = 2; length <= 3; ++length) {
+    pattern.resize(length);
+    size_t combinations = length == 2 ? 11 * 11 : 11 * 11 * 11;
+    for (size_t n = 0; n < combinations; ++n) {
+      for (size_t i = 0, rest = n; i < length; ++i, rest /= 11)
+        pattern[i] = symbols[rest % 11];
+      check(matches(index, pattern) == scan(present, pattern),
+            "scan: pattern " + pattern);
+    }
+  }
+
+  // Dropping a code takes it out of every pattern
+  index.set(111, false);
+  present[111] = false;
+  check(matches(index, "1?1") == scan(present, "1?1"), "scan: dropped code");
+  check(matches(index, "1").empty() && matches(index, "1111").empty(),
+        "scan: patterns of the wrong length");
+}
+
+// The fixture fills 10..90 and 111, 123, 456, 789
+void testDatabase(const Database &db) {
+  const WildcardIndex &index = db.wildcardIndex();
+  check(index.codeCount() == 13, "database: typable codes with candidates");
+  check(matches(index, "??") ==
+            std::vector<int>{10, 20, 30, 40, 50, 60, 70, 80, 90},
+        "database: every one-digit code");
+  check(matches(index, "???") == std::vector<int>{111, 123, 456, 789},
+        "database: every three-digit code");
+  check(matches(index, "4?6") == std::vector<int>{456},
+        "database: middle digit unknown");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <fixture.sql>" << std::endl;
+    return 2;
+  }
+  Database db;
+  if (int status = fixture::open(db, argv[1]))
+    return status;
+
+  testAgainstScan();
+  testDatabase(db);
+
+  std::cout << "[tq9-test-wildcard] " << failures << " failures" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
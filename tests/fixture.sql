@@ -0,0 +1,57 @@
+-- A few dozen rows in the shape of data/dataset.db, enough for the tests to
+-- reach every mode: bracket pairs under code 1, one-digit codes ended with
+-- 0, three-digit codes (111 runs to a second page), the shortcut pages,
+-- related phrases and readings shared by more than one character.
+
+CREATE TABLE mapped_table (id INTEGER PRIMARY KEY, characters TEXT);
+CREATE TABLE related_candidates_table (character TEXT PRIMARY KEY,
+                                       candidates TEXT);
+CREATE TABLE word_meta (char TEXT, ping TEXT, ping2 TEXT);
+CREATE TABLE ts_chinese_table (traditional TEXT, simplified TEXT);
+
+INSERT INTO mapped_table VALUES
+  (1, '「」『』（）《》'),
+  (10, '一二三'),
+  (20, '人入八'),
+  (30, '大天夫'),
+  (40, '口中日'),
+  (50, '山出'),
+  (60, '水小'),
+  (70, '女好'),
+  (80, '木本'),
+  (90, '火心'),
+  (111, '的了在是我有他这个们来上'),
+  (123, '起去子事'),
+  (456, '好你学生泥'),
+  (789, '国家时'),
+  (1000, '，。！？：；'),
+  (1001, '，。'),
+  (1002, '！？'),
+  (1003, '：；'),
+  (1004, '、…'),
+  (1005, '—·'),
+  (1006, '（）'),
+  (1007, '《》'),
+  (1008, '「」'),
+  (1009, '『』');
+
+INSERT INTO related_candidates_table VALUES
+  ('一', '一个 一起'),
+  ('我', '我们 我的'),
+  ('你', '你好 你们'),
+  ('好', '好人'),
+  ('国', '国家');
+
+INSERT INTO word_meta VALUES
+  ('是', 'shi', 'shi4'),
+  ('事', 'shi', 'shi4'),
+  ('时', 'shi', 'shi2'),
+  ('你', 'ni', 'ni3'),
+  ('泥', 'ni', 'ni2'),
+  ('好', 'hao', 'hao3');
+
+INSERT INTO ts_chinese_table VALUES
+  ('們', '们'),
+  ('個', '个'),
+  ('國', '国'),
+  ('來', '来');